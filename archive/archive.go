@@ -0,0 +1,483 @@
+// Package archive implements muon's single-file asset archive: a sorted index followed by page-aligned entries,
+// memory-mapped at runtime so opening an archive costs the same regardless of its size and only the pages of
+// assets actually served become resident. On platforms without mmap the archive is read into memory instead.
+package archive
+
+import (
+	"bytes"
+	"crypto/sha256"
+	"encoding/binary"
+	"encoding/hex"
+	"errors"
+	"io"
+	"net/http"
+	"os"
+	"path"
+	"path/filepath"
+	"sort"
+	"strings"
+	"time"
+)
+
+// Layout, all integers little endian:
+//
+//	header  magic[8] count:u32 names:u32
+//	index   count × { name:u32 nameLen:u32 offset:u64 size:u64 modTime:i64 hash[16] }, sorted by name
+//	names   the concatenated names, each a slash separated path starting with /
+//	data    each entry starting on a page boundary
+const (
+	magic      = "MUONARC1"
+	headerSize = 16
+	entrySize  = 48
+	pageSize   = 4096
+)
+
+// ErrFormat is returned when opening a file that is not a valid archive
+var ErrFormat = errors.New("not a muon archive")
+
+// Archive is an open, memory-mapped asset archive. It serves its files as an http.Handler and
+// can be used as an http.FileSystem.
+type Archive struct {
+	data  []byte
+	count int
+	names []byte
+	unmap func() error
+}
+
+// Open memory-maps the archive at name
+func Open(name string) (*Archive, error) {
+	f, err := os.Open(name)
+
+	if err != nil {
+		return nil, err
+	}
+
+	defer f.Close()
+
+	info, err := f.Stat()
+
+	if err != nil {
+		return nil, err
+	}
+
+	if info.Size() < headerSize {
+		return nil, ErrFormat
+	}
+
+	data, unmap, err := mmap(f, int(info.Size()))
+
+	if err != nil {
+		return nil, err
+	}
+
+	a, err := parse(data)
+
+	if err != nil {
+		unmap()
+		return nil, err
+	}
+
+	a.unmap = unmap
+
+	return a, nil
+}
+
+// parse validates the header and index bounds of data without touching any entry
+func parse(data []byte) (*Archive, error) {
+	if len(data) < headerSize || string(data[:8]) != magic {
+		return nil, ErrFormat
+	}
+
+	count := int(binary.LittleEndian.Uint32(data[8:]))
+	names := int(binary.LittleEndian.Uint32(data[12:]))
+	end := headerSize + count*entrySize
+
+	if count < 0 || names < 0 || end+names > len(data) {
+		return nil, ErrFormat
+	}
+
+	return &Archive{
+		data:  data,
+		count: count,
+		names: data[end : end+names],
+	}, nil
+}
+
+// Close unmaps the archive, slices returned by Bytes must not be used afterwards
+func (a *Archive) Close() error {
+	if a.unmap == nil {
+		return nil
+	}
+
+	err := a.unmap()
+	a.unmap, a.data = nil, nil
+
+	return err
+}
+
+type entry struct {
+	name    string
+	offset  uint64
+	size    uint64
+	modTime time.Time
+	hash    []byte
+}
+
+func (a *Archive) name(i int) []byte {
+	e := a.data[headerSize+i*entrySize:]
+	off, n := binary.LittleEndian.Uint32(e), binary.LittleEndian.Uint32(e[4:])
+
+	if uint64(off)+uint64(n) > uint64(len(a.names)) {
+		return nil
+	}
+
+	return a.names[off : off+n]
+}
+
+func (a *Archive) entry(i int) (entry, bool) {
+	e := a.data[headerSize+i*entrySize:]
+
+	en := entry{
+		name:    string(a.name(i)),
+		offset:  binary.LittleEndian.Uint64(e[8:]),
+		size:    binary.LittleEndian.Uint64(e[16:]),
+		modTime: time.Unix(0, int64(binary.LittleEndian.Uint64(e[24:]))),
+		hash:    e[32:48],
+	}
+
+	return en, en.offset+en.size >= en.offset && en.offset+en.size <= uint64(len(a.data))
+}
+
+// search returns the index of the first name not less than name
+func (a *Archive) search(name string) int {
+	key := []byte(name)
+
+	return sort.Search(a.count, func(i int) bool {
+		return bytes.Compare(a.name(i), key) >= 0
+	})
+}
+
+func (a *Archive) lookup(name string) (entry, bool) {
+	i := a.search(name)
+
+	if i == a.count || string(a.name(i)) != name {
+		return entry{}, false
+	}
+
+	return a.entry(i)
+}
+
+// Bytes returns the contents of the file called name without copying them
+func (a *Archive) Bytes(name string) ([]byte, bool) {
+	e, ok := a.lookup(path.Clean("/" + name))
+
+	if !ok {
+		return nil, false
+	}
+
+	return a.data[e.offset : e.offset+e.size], true
+}
+
+// ServeHTTP serves the archive's files straight from the mapping, with a strong ETag from the stored content
+// hash and support for conditional and range requests. Directories are served by their index.html.
+func (a *Archive) ServeHTTP(w http.ResponseWriter, r *http.Request) {
+	name := path.Clean("/" + r.URL.Path)
+
+	e, ok := a.lookup(name)
+
+	if !ok {
+		e, ok = a.lookup(path.Join(name, "index.html"))
+	}
+
+	if !ok {
+		http.NotFound(w, r)
+		return
+	}
+
+	w.Header().Set("ETag", `"`+hex.EncodeToString(e.hash)+`"`)
+
+	// ServeContent copies from the mapping in 32KB chunks, only the pages being sent are faulted in
+	http.ServeContent(w, r, e.name, e.modTime, bytes.NewReader(a.data[e.offset:e.offset+e.size]))
+}
+
+// Open implements http.FileSystem
+func (a *Archive) Open(name string) (http.File, error) {
+	name = path.Clean("/" + name)
+
+	if e, ok := a.lookup(name); ok {
+		return &file{
+			Reader: bytes.NewReader(a.data[e.offset : e.offset+e.size]),
+			info:   info{e, false},
+		}, nil
+	}
+
+	prefix := strings.TrimSuffix(name, "/") + "/"
+	i := a.search(prefix)
+
+	if i == a.count || !bytes.HasPrefix(a.name(i), []byte(prefix)) {
+		return nil, os.ErrNotExist
+	}
+
+	return &file{
+		Reader: bytes.NewReader(nil),
+		info:   info{entry{name: name}, true},
+		dir:    a,
+		first:  i,
+		prefix: prefix,
+	}, nil
+}
+
+type info struct {
+	e   entry
+	dir bool
+}
+
+func (i info) Name() string       { return path.Base(i.e.name) }
+func (i info) Size() int64        { return int64(i.e.size) }
+func (i info) ModTime() time.Time { return i.e.modTime }
+func (i info) IsDir() bool        { return i.dir }
+func (i info) Sys() interface{}   { return nil }
+
+func (i info) Mode() os.FileMode {
+	if i.dir {
+		return os.ModeDir | 0555
+	}
+
+	return 0444
+}
+
+type file struct {
+	*bytes.Reader
+	info info
+
+	dir    *Archive
+	first  int
+	prefix string
+	listed bool
+}
+
+func (f *file) Close() error {
+	return nil
+}
+
+func (f *file) Stat() (os.FileInfo, error) {
+	return f.info, nil
+}
+
+// Readdir lists the files and directories directly below a directory
+func (f *file) Readdir(count int) ([]os.FileInfo, error) {
+	if f.dir == nil {
+		return nil, errors.New("not a directory")
+	}
+
+	if f.listed {
+		if count > 0 {
+			return nil, io.EOF
+		}
+
+		return nil, nil
+	}
+
+	f.listed = true
+
+	var out []os.FileInfo
+	seen := map[string]bool{}
+
+	for i := f.first; i < f.dir.count; i++ {
+		name := f.dir.name(i)
+
+		if !bytes.HasPrefix(name, []byte(f.prefix)) {
+			break
+		}
+
+		rest := string(name[len(f.prefix):])
+
+		if j := strings.IndexByte(rest, '/'); j >= 0 {
+			if !seen[rest[:j]] {
+				seen[rest[:j]] = true
+				out = append(out, info{entry{name: f.prefix + rest[:j]}, true})
+			}
+
+			continue
+		}
+
+		if e, ok := f.dir.entry(i); ok {
+			out = append(out, info{e, false})
+		}
+	}
+
+	return out, nil
+}
+
+// Write packs every file below dir into an archive written to w
+func Write(w io.Writer, dir string) error {
+	var files []entry
+	var paths []string
+
+	err := filepath.Walk(dir, func(p string, fi os.FileInfo, err error) error {
+		if err != nil || fi.IsDir() {
+			return err
+		}
+
+		// Walk reports symlinks themselves, the archive stores what they point to
+		if fi.Mode()&os.ModeSymlink != 0 {
+			if fi, err = os.Stat(p); err != nil {
+				return err
+			}
+		}
+
+		if !fi.Mode().IsRegular() {
+			return errors.New(p + " is not a regular file")
+		}
+
+		rel, err := filepath.Rel(dir, p)
+
+		if err != nil {
+			return err
+		}
+
+		files = append(files, entry{
+			name:    "/" + filepath.ToSlash(rel),
+			size:    uint64(fi.Size()),
+			modTime: fi.ModTime(),
+		})
+		paths = append(paths, p)
+
+		return nil
+	})
+
+	if err != nil {
+		return err
+	}
+
+	order := make([]int, len(files))
+
+	for i := range order {
+		order[i] = i
+	}
+
+	sort.Slice(order, func(i, j int) bool {
+		return files[order[i]].name < files[order[j]].name
+	})
+
+	var names bytes.Buffer
+	index := make([]byte, len(files)*entrySize)
+
+	offset := uint64(headerSize + len(index))
+
+	for _, i := range order {
+		offset += uint64(len(files[i].name))
+	}
+
+	for n, i := range order {
+		f := &files[i]
+
+		sum, err := hashFile(paths[i])
+
+		if err != nil {
+			return err
+		}
+
+		offset = align(offset)
+		f.offset, f.hash = offset, sum
+		offset += f.size
+
+		e := index[n*entrySize:]
+		binary.LittleEndian.PutUint32(e, uint32(names.Len()))
+		binary.LittleEndian.PutUint32(e[4:], uint32(len(f.name)))
+		binary.LittleEndian.PutUint64(e[8:], f.offset)
+		binary.LittleEndian.PutUint64(e[16:], f.size)
+		binary.LittleEndian.PutUint64(e[24:], uint64(f.modTime.UnixNano()))
+		copy(e[32:48], f.hash)
+
+		names.WriteString(f.name)
+	}
+
+	var header [headerSize]byte
+	copy(header[:], magic)
+	binary.LittleEndian.PutUint32(header[8:], uint32(len(files)))
+	binary.LittleEndian.PutUint32(header[12:], uint32(names.Len()))
+
+	cw := &countWriter{w: w}
+
+	cw.Write(header[:])
+	cw.Write(index)
+	cw.Write(names.Bytes())
+
+	var pad [pageSize]byte
+
+	for _, i := range order {
+		f := files[i]
+
+		if cw.err != nil {
+			return cw.err
+		}
+
+		cw.Write(pad[:f.offset-cw.n])
+
+		if err := copyFile(cw, paths[i], f.size); err != nil {
+			return err
+		}
+	}
+
+	return cw.err
+}
+
+func align(offset uint64) uint64 {
+	return (offset + pageSize - 1) &^ (pageSize - 1)
+}
+
+func hashFile(name string) ([]byte, error) {
+	f, err := os.Open(name)
+
+	if err != nil {
+		return nil, err
+	}
+
+	defer f.Close()
+
+	h := sha256.New()
+
+	if _, err := io.Copy(h, f); err != nil {
+		return nil, err
+	}
+
+	return h.Sum(nil)[:16], nil
+}
+
+func copyFile(w io.Writer, name string, size uint64) error {
+	f, err := os.Open(name)
+
+	if err != nil {
+		return err
+	}
+
+	defer f.Close()
+
+	// copy exactly the size recorded in the index, even if the file is growing
+	if _, err := io.CopyN(w, f, int64(size)); err == io.EOF {
+		return errors.New(name + " changed while being packed")
+	} else if err != nil {
+		return err
+	}
+
+	return nil
+}
+
+type countWriter struct {
+	w   io.Writer
+	n   uint64
+	err error
+}
+
+func (c *countWriter) Write(b []byte) (int, error) {
+	if c.err != nil {
+		return 0, c.err
+	}
+
+	n, err := c.w.Write(b)
+	c.n += uint64(n)
+	c.err = err
+
+	return n, err
+}
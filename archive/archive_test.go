@@ -0,0 +1,172 @@
+package archive
+
+import (
+	"errors"
+	"io/ioutil"
+	"net/http"
+	"net/http/httptest"
+	"os"
+	"path/filepath"
+	"testing"
+)
+
+func TestArchive(t *testing.T) {
+	dir, err := ioutil.TempDir("", "archive")
+
+	if err != nil {
+		t.Fatal(err)
+	}
+
+	defer os.RemoveAll(dir)
+
+	os.MkdirAll(filepath.Join(dir, "js"), 0755)
+	ioutil.WriteFile(filepath.Join(dir, "index.html"), []byte("<h1>Hello</h1>"), 0644)
+	ioutil.WriteFile(filepath.Join(dir, "js", "app.js"), []byte("console.log(1)"), 0644)
+
+	out, err := ioutil.TempFile("", "assets")
+
+	if err != nil {
+		t.Fatal(err)
+	}
+
+	if err := Write(out, dir); err != nil {
+		t.Fatal(err)
+	}
+
+	out.Close()
+	defer os.Remove(out.Name())
+
+	a, err := Open(out.Name())
+
+	if err != nil {
+		t.Fatal(err)
+	}
+
+	defer a.Close()
+
+	if b, ok := a.Bytes("js/app.js"); !ok || string(b) != "console.log(1)" {
+		t.Errorf("js/app.js was not read back, got %q", b)
+	}
+
+	rec := httptest.NewRecorder()
+	a.ServeHTTP(rec, httptest.NewRequest("GET", "/", nil))
+
+	if rec.Body.String() != "<h1>Hello</h1>" {
+		t.Errorf("/ was not served from index.html, got %q", rec.Body.String())
+	}
+
+	req := httptest.NewRequest("GET", "/js/app.js", nil)
+	req.Header.Set("If-None-Match", rec.Header().Get("ETag"))
+	rec = httptest.NewRecorder()
+	a.ServeHTTP(rec, req)
+
+	if rec.Code != http.StatusOK {
+		t.Errorf("another file's ETag matched, got %d", rec.Code)
+	}
+
+	req.Header.Set("If-None-Match", rec.Header().Get("ETag"))
+	rec = httptest.NewRecorder()
+	a.ServeHTTP(rec, req)
+
+	if rec.Code != http.StatusNotModified {
+		t.Errorf("conditional request was not answered with 304, got %d", rec.Code)
+	}
+
+	f, err := a.Open("/")
+
+	if err != nil {
+		t.Fatal(err)
+	}
+
+	list, _ := f.Readdir(-1)
+
+	if len(list) != 2 {
+		t.Errorf("root directory did not list index.html and js, got %d", len(list))
+	}
+}
+
+func TestWriteSymlink(t *testing.T) {
+	dir, err := ioutil.TempDir("", "archive")
+
+	if err != nil {
+		t.Fatal(err)
+	}
+
+	defer os.RemoveAll(dir)
+
+	ioutil.WriteFile(filepath.Join(dir, "target.txt"), []byte("linked contents"), 0644)
+
+	if err := os.Symlink("target.txt", filepath.Join(dir, "link.txt")); err != nil {
+		t.Skip("symlinks are not supported here:", err)
+	}
+
+	out, err := ioutil.TempFile("", "assets")
+
+	if err != nil {
+		t.Fatal(err)
+	}
+
+	defer os.Remove(out.Name())
+
+	if err := Write(out, dir); err != nil {
+		t.Fatal(err)
+	}
+
+	out.Close()
+
+	a, err := Open(out.Name())
+
+	if err != nil {
+		t.Fatal(err)
+	}
+
+	defer a.Close()
+
+	if b, ok := a.Bytes("link.txt"); !ok || string(b) != "linked contents" {
+		t.Errorf("symlink was not archived as its target, got %q", b)
+	}
+
+	os.Symlink(os.TempDir(), filepath.Join(dir, "dir"))
+
+	if err := Write(ioutil.Discard, dir); err == nil {
+		t.Error("a symlinked directory was archived")
+	}
+}
+
+type failWriter struct {
+	left int
+}
+
+var errFull = errors.New("disk full")
+
+func (f *failWriter) Write(b []byte) (int, error) {
+	if len(b) > f.left {
+		n := f.left
+		f.left = 0
+		return n, errFull
+	}
+
+	f.left -= len(b)
+
+	return len(b), nil
+}
+
+func TestWriteError(t *testing.T) {
+	dir, err := ioutil.TempDir("", "archive")
+
+	if err != nil {
+		t.Fatal(err)
+	}
+
+	defer os.RemoveAll(dir)
+
+	ioutil.WriteFile(filepath.Join(dir, "a.txt"), make([]byte, 10000), 0644)
+	ioutil.WriteFile(filepath.Join(dir, "b.txt"), []byte("b"), 0644)
+
+	// fail within the header, the padding and the first file's contents
+	for _, left := range []int{8, 200, 5000} {
+		if err := Write(&failWriter{left: left}, dir); err != errFull {
+			t.Errorf("write failing after %d bytes returned %v", left, err)
+		}
+	}
+}
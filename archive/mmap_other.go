@@ -0,0 +1,20 @@
+//go:build !aix && !darwin && !dragonfly && !freebsd && !linux && !netbsd && !openbsd && !solaris && !windows
+// +build !aix,!darwin,!dragonfly,!freebsd,!linux,!netbsd,!openbsd,!solaris,!windows
+
+package archive
+
+import (
+	"io"
+	"os"
+)
+
+// mmap reads the whole file into memory on platforms without memory mapping
+func mmap(f *os.File, size int) ([]byte, func() error, error) {
+	data := make([]byte, size)
+
+	if _, err := io.ReadFull(f, data); err != nil {
+		return nil, nil, err
+	}
+
+	return data, func() error { return nil }, nil
+}
@@ -0,0 +1,36 @@
+//go:build windows
+// +build windows
+
+package archive
+
+import (
+	"os"
+	"reflect"
+	"syscall"
+	"unsafe"
+)
+
+func mmap(f *os.File, size int) ([]byte, func() error, error) {
+	h, err := syscall.CreateFileMapping(syscall.Handle(f.Fd()), nil, syscall.PAGE_READONLY, 0, 0, nil)
+
+	if err != nil {
+		return nil, nil, err
+	}
+
+	addr, err := syscall.MapViewOfFile(h, syscall.FILE_MAP_READ, 0, 0, uintptr(size))
+
+	syscall.CloseHandle(h)
+
+	if err != nil {
+		return nil, nil, err
+	}
+
+	var data []byte
+
+	hdr := (*reflect.SliceHeader)(unsafe.Pointer(&data))
+	hdr.Data, hdr.Len, hdr.Cap = addr, size, size
+
+	return data, func() error {
+		return syscall.UnmapViewOfFile(addr)
+	}, nil
+}
@@ -0,0 +1,88 @@
+package muon
+
+import (
+	"errors"
+	"net/http"
+	"path/filepath"
+
+	. "github.com/ImVexed/muon/ultralight"
+)
+
+// assetURL is loaded instead of the handler's address when pages are served from Config.FileSystem
+const assetURL = "file:///index.html"
+
+// mountAssets points the engine's file system at an http.Dir so pages and their assets are read straight from
+// disk instead of over a loopback socket. Other file systems, such as an archive.Archive, are served through the
+// handler path instead, see mounted.
+func (w *Window) mountAssets(settings ULSettings) {
+	if !w.mounted() {
+		return
+	}
+
+	abs, err := filepath.Abs(string(w.cfg.FileSystem.(http.Dir)))
+
+	if err != nil {
+		w.assetErr = err
+		return
+	}
+
+	str := UlCreateString(abs + string(filepath.Separator))
+	UlSettingsSetFileSystemPath(settings, str)
+	UlDestroyString(str)
+}
+
+// mounted reports whether pages are loaded from the engine's file system rather than served by a handler
+func (w *Window) mounted() bool {
+	_, ok := w.cfg.FileSystem.(http.Dir)
+
+	return ok && !w.cfg.Headless
+}
+
+// Load serves the Window's handler and navigates to it without running a frame loop, for headless Windows
+// driven with Pump or Advance
+func (w *Window) Load() error {
+	if !w.cfg.Headless {
+		return errors.New("Load requires a headless Window, use Start")
+	}
+
+	return w.load()
+}
+
+func (w *Window) load() error {
+	if w.assetErr != nil {
+		return w.assetErr
+	}
+
+	addr := assetURL
+
+	if !w.mounted() {
+		handler := w.handler
+
+		if handler == nil {
+			handler = http.FileServer(w.cfg.FileSystem)
+		}
+
+		if w.cfg.Cache != nil {
+			c := Cached(handler, w.cfg.Cache).(*cachedHandler)
+
+			if w.cfg.FileSystem != nil {
+				go c.warm(w.cfg.FileSystem, "/")
+			}
+
+			handler = c
+		}
+
+		var err error
+
+		if addr, err = serveHandler(handler); err != nil {
+			return err
+		}
+	}
+
+	url := UlCreateString(addr)
+	defer UlDestroyString(url)
+
+	UlViewLoadURL(w.view, url)
+
+	return nil
+}
@@ -0,0 +1,229 @@
+package muon
+
+import (
+	"errors"
+	"reflect"
+	"strings"
+
+	. "github.com/ImVexed/muon/ultralight"
+)
+
+// ErrPageUnloaded is returned by a Future whose Promise was still pending when its page was unloaded
+var ErrPageUnloaded = errors.New("page was unloaded before the Promise settled")
+
+// ErrWindowClosed is returned by a Future whose Promise was still pending when its Window was closed
+var ErrWindowClosed = errors.New("Window was closed before the Promise settled")
+
+// Future is the eventual result of a JS value that may be a Promise
+type Future struct {
+	done chan struct{}
+	val  interface{}
+	err  error
+}
+
+type awaiting struct {
+	future *Future
+	ret    reflect.Type
+	// queued is set until the await's task runs, navigation leaves it for the next page
+	queued bool
+}
+
+// Done is closed once the result is available
+func (f *Future) Done() <-chan struct{} {
+	return f.done
+}
+
+// Wait blocks until the result is available and returns it
+func (f *Future) Wait() (interface{}, error) {
+	<-f.done
+	return f.val, f.err
+}
+
+func (f *Future) resolve(val interface{}, err error) {
+	f.val, f.err = val, err
+	close(f.done)
+}
+
+// EvalAwait evaluates a given JavaScript string on the next update tick and, if the result is a Promise, waits for
+// it to settle without blocking the UI thread. It is safe to call from any goroutine. `ret` is necessary for JSON
+// serialization if an object is returned. An exception thrown by js fails the Future like a rejected Promise.
+func (w *Window) EvalAwait(js string, ret reflect.Type) *Future {
+	f := &Future{done: make(chan struct{})}
+	id, ok := w.queue(f, ret)
+
+	if !ok {
+		return f
+	}
+
+	w.post(func() {
+		if !w.start(id) {
+			return
+		}
+
+		val, err := w.script(js)
+
+		if err != nil {
+			w.fail(id, err)
+			return
+		}
+
+		w.await(UlViewGetJSContext(w.view), val, id)
+	})
+
+	return f
+}
+
+// CallAwait calls the JS function found at the dotted path fn with args on the next update tick and waits for its
+// result like EvalAwait does. Refs can be passed as arguments.
+func (w *Window) CallAwait(fn string, ret reflect.Type, args ...interface{}) *Future {
+	f := &Future{done: make(chan struct{})}
+	id, ok := w.queue(f, ret)
+
+	if !ok {
+		return f
+	}
+
+	w.post(func() {
+		if !w.start(id) {
+			return
+		}
+
+		ctx := UlViewGetJSContext(w.view)
+		path := strings.Split(fn, ".")
+
+		obj := jsLookup(ctx, path...)
+
+		if obj == nil || !JSObjectIsFunction(ctx, obj) {
+			w.fail(id, errors.New(fn+" is not a function"))
+			return
+		}
+
+		vals := make([]JSValueRef, len(args))
+
+		for i, arg := range args {
+			vals[i] = toJSArg(ctx, arg)
+		}
+
+		exc := make([]JSValueRef, 1)
+		res := JSObjectCallAsFunction(ctx, obj, jsLookup(ctx, path[:len(path)-1]...), uint(len(vals)), vals, exc)
+
+		if exc[0] != nil {
+			w.fail(id, jsError(ctx, exc[0]))
+			return
+		}
+
+		w.await(ctx, res, id)
+	})
+
+	return f
+}
+
+// queue registers f before its task is posted, so a Window closed before the task runs still fails it.
+// A Window that is already closed fails f right away.
+func (w *Window) queue(f *Future, ret reflect.Type) (float64, bool) {
+	w.mu.Lock()
+
+	if w.life.Err() != nil {
+		w.mu.Unlock()
+		f.resolve(nil, ErrWindowClosed)
+		return 0, false
+	}
+
+	w.awaitSeq++
+	id := w.awaitSeq
+	w.awaits[id] = &awaiting{future: f, ret: ret, queued: true}
+	w.mu.Unlock()
+
+	return id, true
+}
+
+// start is called when the task of the await id runs and reports whether it is still pending. From then on the
+// await belongs to the current page and is failed when it is unloaded.
+func (w *Window) start(id float64) bool {
+	w.mu.Lock()
+	defer w.mu.Unlock()
+
+	a, ok := w.awaits[id]
+
+	if ok {
+		a.queued = false
+	}
+
+	return ok
+}
+
+// take removes the await id, returning nil if it was already settled or failed
+func (w *Window) take(id float64) *awaiting {
+	w.mu.Lock()
+	defer w.mu.Unlock()
+
+	a := w.awaits[id]
+	delete(w.awaits, id)
+
+	return a
+}
+
+// fail fails the await id with err unless it was already settled
+func (w *Window) fail(id float64, err error) {
+	if a := w.take(id); a != nil {
+		a.future.resolve(nil, err)
+	}
+}
+
+// settle resolves the await with val converted to its return type
+func (a *awaiting) settle(ctx JSContextRef, val JSValueRef) {
+	rv, err := fromJSValue(ctx, val, a.ret)
+
+	if err != nil {
+		a.future.resolve(nil, err)
+	} else {
+		a.future.resolve(rv.Interface(), nil)
+	}
+}
+
+// await settles the await id with val, or hands val to the JS runtime to report back through settleAwait if it is
+// thenable
+func (w *Window) await(ctx JSContextRef, val JSValueRef, id float64) {
+	if thenable(ctx, val) {
+		jsCall(ctx, []string{"muon", "await"}, val, JSValueMakeNumber(ctx, id))
+		return
+	}
+
+	if a := w.take(id); a != nil {
+		a.settle(ctx, val)
+	}
+}
+
+// settleAwait is called by the JS runtime with (id, ok, value) once an awaited Promise settles
+func (w *Window) settleAwait(ctx JSContextRef, args []JSValueRef) JSValueRef {
+	if len(args) < 3 {
+		return JSValueMakeUndefined(ctx)
+	}
+
+	a := w.take(JSValueToNumber(ctx, args[0], nil))
+
+	switch {
+	case a == nil:
+	case !JSValueToBoolean(ctx, args[1]):
+		a.future.resolve(nil, jsError(ctx, args[2]))
+	default:
+		a.settle(ctx, args[2])
+	}
+
+	return JSValueMakeUndefined(ctx)
+}
+
+// thenable reports whether val is an object with a then method
+func thenable(ctx JSContextRef, val JSValueRef) bool {
+	if !JSValueIsObject(ctx, val) {
+		return false
+	}
+
+	obj := JSValueToObject(ctx, val, nil)
+
+	str := JSStringCreateWithUTF8CString("then")
+	then := JSObjectGetProperty(ctx, obj, str, nil)
+	JSStringRelease(str)
+
+	return JSValueIsObject(ctx, then) && JSObjectIsFunction(ctx, JSValueToObject(ctx, then, nil))
+}
@@ -0,0 +1,306 @@
+package muon
+
+import (
+	"context"
+	"encoding/json"
+	"fmt"
+	"reflect"
+	"strconv"
+	"sync/atomic"
+	"time"
+
+	. "github.com/ImVexed/muon/ultralight"
+)
+
+// BindStats counts what happened to the calls made to a binding
+type BindStats struct {
+	// Calls is the number of times the Go function was invoked
+	Calls uint64
+	// Dropped is the number of calls superseded by a later call under Throttle or Debounce
+	Dropped uint64
+	// Merged is the number of calls folded into a later call under CoalesceLatest
+	Merged uint64
+	// Hits is the number of calls answered from the Memoize cache or joined to an identical call in flight
+	Hits uint64
+}
+
+// BindOption changes how a function registered with Bind is exposed to JS
+type BindOption func(*ipf)
+
+// Batched makes calls to the binding return Promises. Calls made within the same task are queued and
+// flushed from a microtask as a single crossing into Go, with each result resolving its own Promise.
+func Batched() BindOption {
+	return func(f *ipf) {
+		f.batched = true
+	}
+}
+
+// Async makes calls to the binding return Promises and runs the Go function on its own goroutine,
+// so slow functions do not block the UI thread. Batched bindings ignore Async and always run inline.
+func Async() BindOption {
+	return func(f *ipf) {
+		f.async = true
+	}
+}
+
+// Throttle limits the binding to one call into Go per interval. Calls made in between are dropped in favour of
+// the latest one, which is made once the interval has passed; every caller's Promise settles with its result.
+func Throttle(interval time.Duration) BindOption {
+	return func(f *ipf) {
+		f.limit = "throttle"
+		f.interval = interval
+	}
+}
+
+// Debounce delays calls into Go until the binding has not been called for interval, only the latest call is made
+// and every caller's Promise settles with its result.
+func Debounce(interval time.Duration) BindOption {
+	return func(f *ipf) {
+		f.limit = "debounce"
+		f.interval = interval
+	}
+}
+
+// CoalesceLatest merges all calls made to the binding before the next animation frame into the latest one,
+// every caller's Promise settles with its result.
+func CoalesceLatest() BindOption {
+	return func(f *ipf) {
+		f.limit = "coalesce"
+		f.interval = 0
+	}
+}
+
+// binding looks up the named binding, whether or not it is wrapped by a JS stub
+func (w *Window) binding(name string) (*ipf, bool) {
+	w.mu.Lock()
+	defer w.mu.Unlock()
+
+	f, ok := w.callbacks[name]
+
+	if !ok {
+		f, ok = w.callbacks[nativeName(name)]
+	}
+
+	return f, ok
+}
+
+// BindStats returns the call counters of the named binding
+func (w *Window) BindStats(name string) BindStats {
+	f, ok := w.binding(name)
+
+	if !ok {
+		return BindStats{}
+	}
+
+	return BindStats{
+		Calls:   atomic.LoadUint64(&f.stats.Calls),
+		Dropped: atomic.LoadUint64(&f.stats.Dropped),
+		Merged:  atomic.LoadUint64(&f.stats.Merged),
+		Hits:    atomic.LoadUint64(&f.stats.Hits),
+	}
+}
+
+// newIPF reflects on function to build the binding registered as name, with opts applied
+func newIPF(name string, function interface{}, opts []BindOption) *ipf {
+	f := &ipf{
+		Function: reflect.ValueOf(function),
+	}
+
+	t := f.Function.Type()
+
+	for i := 0; i < t.NumIn(); i++ {
+		if i == 0 && t.In(i) == contextType {
+			f.context = true
+			continue
+		}
+
+		f.ParamTypes = append(f.ParamTypes, t.In(i))
+	}
+
+	if t.NumOut() > 1 {
+		panic("Too many return values in " + name + "!")
+	}
+
+	for _, opt := range opts {
+		opt(f)
+	}
+
+	return f
+}
+
+// bindRaw registers a native function that receives its JS arguments unconverted
+func (w *Window) bindRaw(name string, fn func(ctx JSContextRef, args []JSValueRef) JSValueRef) {
+	w.mu.Lock()
+	w.callbacks[name] = &ipf{raw: fn}
+	w.mu.Unlock()
+
+	w.addFunction(name)
+}
+
+// nativeName is the global name of the native function backing a binding that is wrapped in a JS stub
+func nativeName(name string) string {
+	return "__muon_" + name
+}
+
+// stubbed reports whether the binding needs a JS stub in front of its native function
+func (f *ipf) stubbed() bool {
+	return f.batched || f.async || f.limit != ""
+}
+
+// stub returns the JS that installs the binding's stub under name
+func (f *ipf) stub(name string, native string) string {
+	opts, _ := json.Marshal(struct {
+		Batched  bool    `json:"batched"`
+		Async    bool    `json:"async"`
+		Context  bool    `json:"context"`
+		Limit    string  `json:"limit,omitempty"`
+		Interval float64 `json:"interval"`
+	}{
+		Batched:  f.batched,
+		Async:    f.async,
+		Context:  f.context,
+		Limit:    f.limit,
+		Interval: float64(f.interval) / float64(time.Millisecond),
+	})
+
+	return "muon.bind(" + strconv.Quote(name) + ", " + strconv.Quote(native) + ", " + string(opts) + ")"
+}
+
+// countStub records the [dropped, merged] counters a stub sends ahead of its arguments and returns the rest
+func (f *ipf) countStub(ctx JSContextRef, args []JSValueRef) []JSValueRef {
+	if len(args) == 0 {
+		return args
+	}
+
+	if JSValueIsArray(ctx, args[0]) {
+		counts := jsArrayElements(ctx, args[0])
+
+		if len(counts) == 2 {
+			atomic.AddUint64(&f.stats.Dropped, uint64(JSValueToNumber(ctx, counts[0], nil)))
+			atomic.AddUint64(&f.stats.Merged, uint64(JSValueToNumber(ctx, counts[1], nil)))
+		}
+	}
+
+	return args[1:]
+}
+
+// callBatch invokes the function once for every argument list in the JS array args[0], returning an array of [ok, value] pairs
+func (f *ipf) callBatch(gctx context.Context, ctx JSContextRef, args []JSValueRef) JSValueRef {
+	if len(args) == 0 || !JSValueIsArray(ctx, args[0]) {
+		return jsArray(ctx, nil)
+	}
+
+	calls := jsArrayElements(ctx, args[0])
+	results := make([]JSValueRef, len(calls))
+
+	for i, call := range calls {
+		var params []JSValueRef
+
+		if JSValueIsArray(ctx, call) {
+			params = jsArrayElements(ctx, call)
+		}
+
+		val, err := f.call(gctx, ctx, params)
+
+		if err != nil {
+			str := JSStringCreateWithUTF8CString(err.Error())
+			results[i] = jsArray(ctx, []JSValueRef{JSValueMakeBoolean(ctx, false), JSValueMakeString(ctx, str)})
+			JSStringRelease(str)
+			continue
+		}
+
+		results[i] = jsArray(ctx, []JSValueRef{JSValueMakeBoolean(ctx, true), val})
+	}
+
+	return jsArray(ctx, results)
+}
+
+// callAsync decodes the arguments following the call id in args and runs the function off the UI thread,
+// settling the caller's Promise on a later tick
+func (w *Window) callAsync(ctx JSContextRef, f *ipf, args []JSValueRef) JSValueRef {
+	if len(args) == 0 {
+		return JSValueMakeUndefined(ctx)
+	}
+
+	id := JSValueToNumber(ctx, args[0], nil)
+
+	// ids restart with every page, so results are tagged with the page that made the call
+	gen, gctx := w.pageState()
+
+	settle := func(val []reflect.Value, err error) {
+		w.post(func() {
+			w.settle(gen, id, val, err)
+		})
+	}
+
+	params, err := f.decode(ctx, args[1:])
+
+	if err != nil {
+		settle(nil, err)
+		return JSValueMakeUndefined(ctx)
+	}
+
+	// a shared memoized execution outlives any single caller, so only per-call contexts can be aborted
+	if f.context && f.memo == nil {
+		var cancel context.CancelFunc
+		gctx, cancel = context.WithCancel(gctx)
+
+		w.track(gen, id, cancel)
+
+		settle = func(val []reflect.Value, err error) {
+			w.untrack(gen, id)
+
+			w.post(func() {
+				w.settle(gen, id, val, err)
+			})
+		}
+	}
+
+	run := func() (val []reflect.Value, err error) {
+		defer func() {
+			if r := recover(); r != nil {
+				err = fmt.Errorf("%v", r)
+			}
+		}()
+
+		return f.invoke(gctx, params), nil
+	}
+
+	if f.memo != nil {
+		f.memo.do(f, gen, gctx, params, run, settle)
+	} else {
+		go func() {
+			settle(run())
+		}()
+	}
+
+	return JSValueMakeUndefined(ctx)
+}
+
+// settle resolves or rejects the Promise of the async call id made by page generation gen, results for a page
+// that has since been navigated away from are dropped. Must be called on the UI thread.
+func (w *Window) settle(gen uint64, id float64, val []reflect.Value, err error) {
+	w.mu.Lock()
+	stale := w.pages != gen
+	w.mu.Unlock()
+
+	if stale {
+		return
+	}
+
+	ctx := UlViewGetJSContext(w.view)
+
+	var ret JSValueRef
+
+	if err == nil {
+		ret, err = returnValue(ctx, val)
+	}
+
+	if err != nil {
+		str := JSStringCreateWithUTF8CString(err.Error())
+		ret = JSValueMakeString(ctx, str)
+		JSStringRelease(str)
+	}
+
+	jsCall(ctx, []string{"muon", "settle"}, JSValueMakeNumber(ctx, id), JSValueMakeBoolean(ctx, err == nil), ret)
+}
@@ -0,0 +1,374 @@
+package muon
+
+import (
+	"bytes"
+	"compress/gzip"
+	"container/list"
+	"crypto/sha256"
+	"encoding/hex"
+	"net/http"
+	"path"
+	"regexp"
+	"strconv"
+	"strings"
+	"sync"
+	"time"
+)
+
+// CacheConfig contains configurable controls for the response cache put in front of a handler
+type CacheConfig struct {
+	// MaxBytes bounds the memory held by cached responses, defaults to 64MB
+	MaxBytes int64
+	// MaxEntry is the largest response body that is cached, defaults to 8MB
+	MaxEntry int64
+	// TTL bounds how long responses without max-age or Expires are kept, zero keeps them until evicted
+	TTL time.Duration
+}
+
+// fingerprint matches file names carrying a content hash, such as app.3f9a2c1d.js or app-3f9a2c1d7e.css
+var fingerprint = regexp.MustCompile(`[.-]([0-9a-fA-F]{8,})\.[0-9A-Za-z]+$`)
+
+// fingerprinted reports whether name carries a content hash. The hash has to mix digits and letters,
+// so date stamped names such as report-20240115.pdf are not taken for one.
+func fingerprinted(name string) bool {
+	m := fingerprint.FindStringSubmatch(name)
+
+	return m != nil && strings.ContainsAny(m[1], "0123456789") && strings.ContainsAny(m[1], "abcdefABCDEF")
+}
+
+type cachedHandler struct {
+	next     http.Handler
+	maxBytes int64
+	maxEntry int64
+	ttl      time.Duration
+
+	mu      sync.Mutex
+	size    int64
+	entries map[string]*list.Element
+	lru     *list.List
+}
+
+type cachedResponse struct {
+	key       string
+	status    int
+	header    http.Header
+	body      []byte
+	gzipped   []byte
+	etag      string
+	immutable bool
+	expires   time.Time
+}
+
+// Cached wraps handler with an in-memory cache of its GET responses, meant for handlers serving static assets. Cached responses carry a strong ETag
+// computed from their content, conditional requests are answered with 304 Not Modified, fingerprinted file
+// names are marked immutable and compressible bodies are kept gzipped as well. Responses are dropped once their
+// max-age or Expires has passed, or after TTL if they carry neither. Responses with Cache-Control
+// no-store, no-cache or private, that set cookies, or that vary or are already encoded are passed through untouched.
+func Cached(handler http.Handler, cfg *CacheConfig) http.Handler {
+	if cfg == nil {
+		cfg = &CacheConfig{}
+	}
+
+	c := &cachedHandler{
+		next:     handler,
+		maxBytes: cfg.MaxBytes,
+		maxEntry: cfg.MaxEntry,
+		ttl:      cfg.TTL,
+		entries:  make(map[string]*list.Element),
+		lru:      list.New(),
+	}
+
+	if c.maxBytes <= 0 {
+		c.maxBytes = 64 << 20
+	}
+
+	if c.maxEntry <= 0 {
+		c.maxEntry = 8 << 20
+	}
+
+	return c
+}
+
+func (c *cachedHandler) ServeHTTP(w http.ResponseWriter, r *http.Request) {
+	if (r.Method != http.MethodGet && r.Method != http.MethodHead) || r.Header.Get("Range") != "" {
+		c.next.ServeHTTP(w, r)
+		return
+	}
+
+	key := r.URL.RequestURI()
+	e := c.get(key)
+
+	if e == nil {
+		rec := &recorder{header: make(http.Header), status: http.StatusOK}
+
+		// ask for the full response, validators are answered from the cache
+		full := r.Clone(r.Context())
+		full.Method = http.MethodGet
+		full.Header.Del("If-None-Match")
+		full.Header.Del("If-Modified-Since")
+
+		c.next.ServeHTTP(rec, full)
+
+		if e = c.store(key, rec); e == nil {
+			rec.replay(w, r)
+			return
+		}
+	}
+
+	e.serve(w, r)
+}
+
+func (c *cachedHandler) get(key string) *cachedResponse {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+
+	el, ok := c.entries[key]
+
+	if !ok {
+		return nil
+	}
+
+	e := el.Value.(*cachedResponse)
+
+	if !e.expires.IsZero() && time.Now().After(e.expires) {
+		c.remove(el)
+		return nil
+	}
+
+	c.lru.MoveToFront(el)
+
+	return e
+}
+
+func (c *cachedHandler) remove(el *list.Element) {
+	c.lru.Remove(el)
+	delete(c.entries, el.Value.(*cachedResponse).key)
+	c.size -= el.Value.(*cachedResponse).cost()
+}
+
+// expiry returns when a response with header h stops being fresh, the zero time if it never does, and false
+// if it must not be cached at all
+func expiry(h http.Header, ttl time.Duration) (time.Time, bool) {
+	now := time.Now()
+
+	for _, directive := range strings.Split(h.Get("Cache-Control"), ",") {
+		directive = strings.ToLower(strings.TrimSpace(directive))
+
+		if strings.HasPrefix(directive, "max-age=") {
+			age, err := strconv.Atoi(strings.Trim(directive[len("max-age="):], `"`))
+
+			if err != nil || age <= 0 {
+				return time.Time{}, false
+			}
+
+			return now.Add(time.Duration(age) * time.Second), true
+		}
+	}
+
+	if v := h.Get("Expires"); v != "" {
+		expires, err := http.ParseTime(v)
+
+		return expires, err == nil && expires.After(now)
+	}
+
+	if ttl > 0 {
+		return now.Add(ttl), true
+	}
+
+	return time.Time{}, true
+}
+
+// store caches a recorded response if it may be cached, reporting nil otherwise
+func (c *cachedHandler) store(key string, rec *recorder) *cachedResponse {
+	cc := strings.ToLower(rec.header.Get("Cache-Control"))
+
+	if rec.status != http.StatusOK || int64(rec.body.Len()) > c.maxEntry || rec.header.Get("Set-Cookie") != "" ||
+		strings.Contains(cc, "no-store") || strings.Contains(cc, "no-cache") || strings.Contains(cc, "private") ||
+		rec.header.Get("Vary") != "" || rec.header.Get("Content-Encoding") != "" {
+		return nil
+	}
+
+	expires, ok := expiry(rec.header, c.ttl)
+
+	if !ok {
+		return nil
+	}
+
+	body := rec.body.Bytes()
+	sum := sha256.Sum256(body)
+
+	e := &cachedResponse{
+		key:       key,
+		status:    rec.status,
+		header:    rec.header,
+		body:      body,
+		etag:      `"` + hex.EncodeToString(sum[:16]) + `"`,
+		immutable: fingerprinted(path.Base(strings.SplitN(key, "?", 2)[0])),
+		expires:   expires,
+	}
+
+	e.header.Del("Content-Length")
+	e.header.Del("Date")
+
+	if e.header.Get("Content-Type") == "" {
+		e.header.Set("Content-Type", http.DetectContentType(body))
+	}
+
+	if len(body) > 1024 && compressible(e.header.Get("Content-Type")) {
+		var buf bytes.Buffer
+		gz, _ := gzip.NewWriterLevel(&buf, gzip.BestCompression)
+		gz.Write(body)
+		gz.Close()
+
+		if buf.Len() < len(body) {
+			e.gzipped = buf.Bytes()
+		}
+	}
+
+	size := int64(len(e.body) + len(e.gzipped))
+
+	c.mu.Lock()
+	defer c.mu.Unlock()
+
+	if el, ok := c.entries[key]; ok {
+		c.remove(el)
+	}
+
+	c.entries[key] = c.lru.PushFront(e)
+	c.size += size
+
+	for c.size > c.maxBytes && c.lru.Len() > 1 {
+		c.remove(c.lru.Back())
+	}
+
+	return e
+}
+
+func (e *cachedResponse) cost() int64 {
+	return int64(len(e.body) + len(e.gzipped))
+}
+
+func (e *cachedResponse) serve(w http.ResponseWriter, r *http.Request) {
+	h := w.Header()
+
+	for k, v := range e.header {
+		h[k] = append([]string(nil), v...)
+	}
+
+	h.Set("ETag", e.etag)
+
+	if e.immutable {
+		h.Set("Cache-Control", "public, max-age=31536000, immutable")
+	} else if h.Get("Cache-Control") == "" {
+		// revalidating is a cheap 304 from memory
+		h.Set("Cache-Control", "no-cache")
+	}
+
+	if e.gzipped != nil {
+		h.Add("Vary", "Accept-Encoding")
+	}
+
+	if matchETag(r.Header.Get("If-None-Match"), e.etag) {
+		w.WriteHeader(http.StatusNotModified)
+		return
+	}
+
+	body := e.body
+
+	if e.gzipped != nil && strings.Contains(r.Header.Get("Accept-Encoding"), "gzip") {
+		body = e.gzipped
+		h.Set("Content-Encoding", "gzip")
+	}
+
+	h.Set("Content-Length", strconv.Itoa(len(body)))
+	w.WriteHeader(e.status)
+
+	if r.Method != http.MethodHead {
+		w.Write(body)
+	}
+}
+
+// matchETag reports whether an If-None-Match header matches etag, using the weak comparison it calls for
+func matchETag(header, etag string) bool {
+	for _, tag := range strings.Split(header, ",") {
+		tag = strings.TrimPrefix(strings.TrimSpace(tag), "W/")
+
+		if tag == "*" || tag == etag {
+			return true
+		}
+	}
+
+	return false
+}
+
+func compressible(contentType string) bool {
+	ct := strings.ToLower(contentType)
+
+	return strings.HasPrefix(ct, "text/") || strings.Contains(ct, "javascript") || strings.Contains(ct, "json") ||
+		strings.Contains(ct, "xml") || strings.Contains(ct, "svg") || strings.Contains(ct, "wasm")
+}
+
+// recorder buffers a response so it can be cached before being written
+type recorder struct {
+	header http.Header
+	status int
+	wrote  bool
+	body   bytes.Buffer
+}
+
+func (r *recorder) Header() http.Header {
+	return r.header
+}
+
+func (r *recorder) WriteHeader(status int) {
+	if !r.wrote {
+		r.status, r.wrote = status, true
+	}
+}
+
+func (r *recorder) Write(b []byte) (int, error) {
+	r.wrote = true
+	return r.body.Write(b)
+}
+
+// replay writes the recorded response as is, for responses that were not cached
+func (r *recorder) replay(w http.ResponseWriter, req *http.Request) {
+	for k, v := range r.header {
+		w.Header()[k] = v
+	}
+
+	w.WriteHeader(r.status)
+
+	if req.Method != http.MethodHead {
+		w.Write(r.body.Bytes())
+	}
+}
+
+// warm fills the cache with every file of fs at startup, so content hashes are ready before the first request
+func (c *cachedHandler) warm(fs http.FileSystem, name string) {
+	f, err := fs.Open(name)
+
+	if err != nil {
+		return
+	}
+
+	info, err := f.Stat()
+
+	if err != nil || !info.IsDir() {
+		f.Close()
+
+		if err == nil {
+			req, _ := http.NewRequest(http.MethodGet, name, nil)
+			c.ServeHTTP(&recorder{header: make(http.Header)}, req)
+		}
+
+		return
+	}
+
+	entries, _ := f.Readdir(-1)
+	f.Close()
+
+	for _, e := range entries {
+		c.warm(fs, path.Join(name, e.Name()))
+	}
+}
@@ -0,0 +1,110 @@
+package muon
+
+import (
+	"context"
+	"reflect"
+	"unsafe"
+
+	. "github.com/ImVexed/muon/ultralight"
+)
+
+var contextType = reflect.TypeOf((*context.Context)(nil)).Elem()
+
+// pageContext returns the context that is cancelled when the current page is navigated away from or the Window closes
+func (w *Window) pageContext() context.Context {
+	w.mu.Lock()
+	defer w.mu.Unlock()
+
+	return w.page
+}
+
+// pageState returns the generation of the current page along with its context
+func (w *Window) pageState() (uint64, context.Context) {
+	w.mu.Lock()
+	defer w.mu.Unlock()
+
+	return w.pages, w.page
+}
+
+// call identifies an async call, ids restart with every page so they are paired with the page generation
+type call struct {
+	gen uint64
+	id  float64
+}
+
+// track remembers the cancel function of the async call id made by page generation gen until it settles or is aborted
+func (w *Window) track(gen uint64, id float64, cancel context.CancelFunc) {
+	w.mu.Lock()
+	w.inflight[call{gen, id}] = cancel
+	w.mu.Unlock()
+}
+
+func (w *Window) untrack(gen uint64, id float64) {
+	w.mu.Lock()
+	cancel, ok := w.inflight[call{gen, id}]
+	delete(w.inflight, call{gen, id})
+	w.mu.Unlock()
+
+	if ok {
+		cancel()
+	}
+}
+
+// abort is bound for the JS runtime, which calls it when the AbortSignal passed to an async call fires
+func (w *Window) abort(id float64) {
+	w.mu.Lock()
+	gen := w.pages
+	w.mu.Unlock()
+
+	w.untrack(gen, id)
+}
+
+// beginLoading cancels every call made by the page that is being navigated away from and invalidates its Refs
+func (w *Window) beginLoading() {
+	w.mu.Lock()
+	w.pages++
+	w.leave()
+	w.page, w.leave = context.WithCancel(w.life)
+	w.inflight = make(map[call]context.CancelFunc)
+	var unloaded []*awaiting
+
+	for id, a := range w.awaits {
+		if !a.queued {
+			unloaded = append(unloaded, a)
+			delete(w.awaits, id)
+		}
+	}
+	w.mu.Unlock()
+
+	for _, a := range unloaded {
+		a.future.resolve(nil, ErrPageUnloaded)
+	}
+}
+
+// close cancels every outstanding call and quits the app when the Window is closed
+func (w *Window) close(userData unsafe.Pointer) {
+	w.shutdown()
+	UlAppQuit(w.app)
+}
+
+// shutdown cancels every outstanding call and fails every Promise still being awaited
+func (w *Window) shutdown() {
+	w.quit()
+
+	w.mu.Lock()
+	awaits := w.awaits
+	w.awaits = make(map[float64]*awaiting)
+	streams := make([]*stream, 0, len(w.streams))
+	for _, s := range w.streams {
+		streams = append(streams, s)
+	}
+	w.mu.Unlock()
+
+	for _, a := range awaits {
+		a.future.resolve(nil, ErrWindowClosed)
+	}
+
+	for _, s := range streams {
+		s.stop()
+	}
+}
@@ -0,0 +1,189 @@
+package muon
+
+import (
+	"strconv"
+	"sync/atomic"
+	"time"
+)
+
+// clockJS replaces the page's timers, animation frames and clocks with ones driven by muon.clock.advance,
+// the page's clock starts at 2020-01-01T00:00:00Z
+const clockJS = `(function (g) {
+	if (g.muon.clock) {
+		return;
+	}
+
+	var RealDate = g.Date, slice = Array.prototype.slice;
+	var origin = 1577836800000, now = 0, seq = 0, timers = {}, frames = [];
+
+	var schedule = function (fn, delay, args, repeat) {
+		var id = ++seq;
+		// like browsers clamp nested timers, never schedule at the current instant so a callback that
+		// keeps rescheduling itself cannot keep advance from reaching its end
+		delay = Math.max(1, +delay || 0);
+		timers[id] = { fn: fn, at: now + delay, args: args, every: repeat ? delay : 0 };
+		return id;
+	};
+
+	g.setTimeout = function (fn, delay) {
+		return schedule(fn, delay, slice.call(arguments, 2), false);
+	};
+
+	g.setInterval = function (fn, delay) {
+		return schedule(fn, delay, slice.call(arguments, 2), true);
+	};
+
+	g.clearTimeout = g.clearInterval = function (id) {
+		delete timers[id];
+	};
+
+	g.requestAnimationFrame = function (fn) {
+		var id = ++seq;
+		frames.push({ id: id, fn: fn });
+		return id;
+	};
+
+	g.cancelAnimationFrame = function (id) {
+		frames = frames.filter(function (f) {
+			return f.id !== id;
+		});
+	};
+
+	var VirtualDate = function () {
+		if (!(this instanceof VirtualDate)) {
+			return new RealDate(origin + now).toString();
+		}
+
+		if (arguments.length === 0) {
+			return new RealDate(origin + now);
+		}
+
+		return new (Function.prototype.bind.apply(RealDate, [null].concat(slice.call(arguments))))();
+	};
+
+	VirtualDate.prototype = RealDate.prototype;
+	VirtualDate.UTC = RealDate.UTC;
+	VirtualDate.parse = RealDate.parse;
+	VirtualDate.now = function () {
+		return origin + now;
+	};
+
+	g.Date = VirtualDate;
+
+	if (g.performance) {
+		g.performance.now = function () {
+			return now;
+		};
+	}
+
+	var run = function (fn, args) {
+		try {
+			if (typeof fn === "function") {
+				fn.apply(g, args);
+			} else {
+				(0, eval)(fn);
+			}
+		} catch (e) {
+			if (g.console) {
+				g.console.error(e);
+			}
+		}
+	};
+
+	g.muon.clock = {
+		// advance runs every timer due within the next ms milliseconds in order, then one round of animation frames
+		advance: function (ms) {
+			var end = now + ms;
+
+			for (;;) {
+				var next = null;
+
+				for (var id in timers) {
+					if (timers[id].at <= end && (next === null || timers[id].at < timers[next].at)) {
+						next = id;
+					}
+				}
+
+				if (next === null) {
+					break;
+				}
+
+				var t = timers[next];
+				now = Math.max(now, t.at);
+
+				if (t.every) {
+					t.at += t.every;
+				} else {
+					delete timers[next];
+				}
+
+				run(t.fn, t.args);
+			}
+
+			now = end;
+
+			var fs = frames;
+			frames = [];
+
+			for (var i = 0; i < fs.length; i++) {
+				run(fs[i].fn, [now]);
+			}
+		}
+	};
+})(this);
+`
+
+// Advance moves the virtual clock of a headless Window with Config.VirtualTime forward by d, one frame at a time.
+// Every frame runs the timers and animation frame callbacks that fall due and renders the view, so animations
+// driven from JS can be fast-forwarded and captured at exact timestamps. Like Pump it must be called from the
+// OS thread that called New.
+func (w *Window) Advance(d time.Duration) {
+	if !w.cfg.VirtualTime {
+		panic("Advance requires a Window with VirtualTime")
+	}
+
+	frame := w.frameTime()
+
+	for d > 0 {
+		step := frame
+
+		if d < step {
+			step = d
+		}
+
+		w.step(step)
+		w.Pump(time.Time{})
+
+		d -= step
+	}
+}
+
+// Clock returns how far the virtual clock has been advanced
+func (w *Window) Clock() time.Duration {
+	return time.Duration(atomic.LoadInt64(&w.virtual))
+}
+
+// elapsed returns the Window's time, on the virtual clock if it has one
+func (w *Window) elapsed() time.Duration {
+	if w.cfg.VirtualTime {
+		return w.Clock()
+	}
+
+	return time.Since(w.born)
+}
+
+func (w *Window) frameTime() time.Duration {
+	if w.cfg.AnimationTimerDelay > 0 {
+		return w.cfg.AnimationTimerDelay
+	}
+
+	return time.Second / 60
+}
+
+// step advances the virtual clock by d without rendering
+func (w *Window) step(d time.Duration) {
+	atomic.AddInt64(&w.virtual, int64(d))
+
+	ms := float64(d) / float64(time.Millisecond)
+	w.evaluate("muon.clock && muon.clock.advance(" + strconv.FormatFloat(ms, 'f', -1, 64) + ")")
+}
@@ -0,0 +1,47 @@
+// Command muonpack packs a directory of assets into a muon archive
+//
+//	muonpack -o assets.muon ./public
+package main
+
+import (
+	"flag"
+	"fmt"
+	"os"
+
+	"github.com/ImVexed/muon/archive"
+)
+
+func main() {
+	out := flag.String("o", "assets.muon", "archive to write")
+	flag.Parse()
+
+	if flag.NArg() != 1 {
+		fmt.Fprintln(os.Stderr, "usage: muonpack [-o assets.muon] dir")
+		os.Exit(2)
+	}
+
+	if err := pack(*out, flag.Arg(0)); err != nil {
+		fmt.Fprintln(os.Stderr, err)
+		os.Exit(1)
+	}
+}
+
+func pack(out, dir string) error {
+	f, err := os.Create(out + ".tmp")
+
+	if err != nil {
+		return err
+	}
+
+	if err := archive.Write(f, dir); err != nil {
+		f.Close()
+		os.Remove(f.Name())
+		return err
+	}
+
+	if err := f.Close(); err != nil {
+		return err
+	}
+
+	return os.Rename(f.Name(), out)
+}
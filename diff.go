@@ -0,0 +1,290 @@
+package muon
+
+import (
+	"context"
+	"encoding/binary"
+	"image"
+)
+
+// DirtyRect is a changed region of a frame with its premultiplied RGBA pixels in tightly packed rows
+type DirtyRect struct {
+	image.Rectangle
+	Pix []byte
+}
+
+// Delta describes how a frame differs from the previous one in a FrameDeltas stream
+type Delta struct {
+	Seq uint64
+	// Keyframe deltas carry the whole frame as a single rect and do not depend on earlier deltas
+	Keyframe bool
+	Width    int
+	Height   int
+	Rects    []DirtyRect
+}
+
+// DeltaConfig contains configurable controls for a FrameDeltas stream
+type DeltaConfig struct {
+	// TileSize is the edge length of the square tiles frames are compared in, defaults to 64
+	TileSize int
+	// KeyframeInterval is the number of deltas between keyframes, defaults to 120
+	KeyframeInterval int
+}
+
+// Differ turns consecutive frames into deltas by hashing fixed size tiles and comparing them with the previous frame
+type Differ struct {
+	tile     int
+	interval int
+
+	seq    uint64
+	since  int
+	width  int
+	height int
+	cols   int
+	hashes []uint64
+	dirty  []bool
+}
+
+// NewDiffer creates a Differ, a nil cfg uses the defaults
+func NewDiffer(cfg *DeltaConfig) *Differ {
+	if cfg == nil {
+		cfg = &DeltaConfig{}
+	}
+
+	d := &Differ{
+		tile:     cfg.TileSize,
+		interval: cfg.KeyframeInterval,
+	}
+
+	if d.tile <= 0 {
+		d.tile = 64
+	}
+
+	if d.interval <= 0 {
+		d.interval = 120
+	}
+
+	return d
+}
+
+// Diff returns the changes in img since the frame previously passed to Diff, or nil if nothing changed
+func (d *Differ) Diff(img *image.RGBA) *Delta {
+	r := img.Rect
+	width, height := r.Dx(), r.Dy()
+	cols, rows := (width+d.tile-1)/d.tile, (height+d.tile-1)/d.tile
+
+	key := d.hashes == nil || width != d.width || height != d.height || d.since >= d.interval
+
+	if key {
+		d.width, d.height, d.cols = width, height, cols
+		d.hashes = make([]uint64, cols*rows)
+		d.dirty = make([]bool, cols*rows)
+	}
+
+	changed := false
+
+	for ty := 0; ty < rows; ty++ {
+		for tx := 0; tx < cols; tx++ {
+			h := d.hash(img, tx, ty)
+			i := ty*cols + tx
+
+			d.dirty[i] = h != d.hashes[i]
+			d.hashes[i] = h
+			changed = changed || d.dirty[i]
+		}
+	}
+
+	if !key && !changed {
+		return nil
+	}
+
+	d.seq++
+
+	delta := &Delta{
+		Seq:      d.seq,
+		Keyframe: key,
+		Width:    width,
+		Height:   height,
+	}
+
+	if key {
+		d.since = 0
+		delta.Rects = []DirtyRect{crop(img, image.Rect(0, 0, width, height))}
+		return delta
+	}
+
+	d.since++
+
+	for _, rect := range d.rects(rows) {
+		delta.Rects = append(delta.Rects, crop(img, rect.Intersect(image.Rect(0, 0, width, height))))
+	}
+
+	return delta
+}
+
+// hash hashes one tile eight bytes at a time
+func (d *Differ) hash(img *image.RGBA, tx, ty int) uint64 {
+	r := img.Rect
+	x0, y0 := tx*d.tile, ty*d.tile
+	x1, y1 := x0+d.tile, y0+d.tile
+
+	if x1 > r.Dx() {
+		x1 = r.Dx()
+	}
+
+	if y1 > r.Dy() {
+		y1 = r.Dy()
+	}
+
+	const prime = 0x100000001b3
+	h := uint64(0xcbf29ce484222325)
+
+	for y := y0; y < y1; y++ {
+		off := img.PixOffset(r.Min.X+x0, r.Min.Y+y)
+		row := img.Pix[off : off+(x1-x0)*4]
+
+		for len(row) >= 8 {
+			h = (h ^ binary.LittleEndian.Uint64(row)) * prime
+			row = row[8:]
+		}
+
+		if len(row) > 0 {
+			h = (h ^ uint64(binary.LittleEndian.Uint32(row))) * prime
+		}
+	}
+
+	return h
+}
+
+// rects merges dirty tiles into rectangles: runs within a row of tiles first, then identical runs in consecutive rows
+func (d *Differ) rects(rows int) []image.Rectangle {
+	var out []image.Rectangle
+	open := map[[2]int]int{}
+
+	for ty := 0; ty < rows; ty++ {
+		next := map[[2]int]int{}
+
+		for tx := 0; tx < d.cols; {
+			if !d.dirty[ty*d.cols+tx] {
+				tx++
+				continue
+			}
+
+			start := tx
+
+			for tx < d.cols && d.dirty[ty*d.cols+tx] {
+				tx++
+			}
+
+			span := [2]int{start, tx}
+
+			if i, ok := open[span]; ok {
+				out[i].Max.Y += d.tile
+				next[span] = i
+				continue
+			}
+
+			next[span] = len(out)
+			out = append(out, image.Rect(start*d.tile, ty*d.tile, tx*d.tile, (ty+1)*d.tile))
+		}
+
+		open = next
+	}
+
+	return out
+}
+
+func crop(img *image.RGBA, rect image.Rectangle) DirtyRect {
+	row := rect.Dx() * 4
+	pix := make([]byte, row*rect.Dy())
+
+	for y := 0; y < rect.Dy(); y++ {
+		off := img.PixOffset(img.Rect.Min.X+rect.Min.X, img.Rect.Min.Y+rect.Min.Y+y)
+		copy(pix[y*row:(y+1)*row], img.Pix[off:off+row])
+	}
+
+	return DirtyRect{rect, pix}
+}
+
+// FrameDeltas streams the changes between the frames a headless Window renders until ctx is done.
+// Frames are copied on the UI thread and diffed on their own goroutine; while the receiver falls behind,
+// intermediate frames are skipped and their changes folded into the next delta. Each frame is read only once,
+// so Snapshot reports nothing new for frames already taken by a stream.
+func (w *Window) FrameDeltas(ctx context.Context, cfg *DeltaConfig) <-chan *Delta {
+	d := NewDiffer(cfg)
+	out := make(chan *Delta)
+	frames := make(chan *image.RGBA, 1)
+	free := make(chan *image.RGBA, 1)
+
+	free <- nil
+
+	w.post(func() {
+		w.observers = append(w.observers, func(img *image.RGBA) bool {
+			if ctx.Err() != nil {
+				return false
+			}
+
+			select {
+			case buf := <-free:
+				frames <- copyRGBA(buf, img)
+			default:
+			}
+
+			return true
+		})
+	})
+
+	go func() {
+		defer close(out)
+
+		for {
+			select {
+			case <-ctx.Done():
+				return
+			case <-w.life.Done():
+				return
+			case img := <-frames:
+				delta := d.Diff(img)
+				free <- img
+
+				if delta == nil {
+					continue
+				}
+
+				select {
+				case out <- delta:
+				case <-ctx.Done():
+					return
+				case <-w.life.Done():
+					return
+				}
+			}
+		}
+	}()
+
+	return out
+}
+
+// observe hands a freshly rendered frame to every observer, must be called on the UI thread
+func (w *Window) observe() {
+	if len(w.observers) == 0 {
+		return
+	}
+
+	frame, ok := w.Snapshot()
+
+	if !ok {
+		return
+	}
+
+	defer frame.Close()
+
+	kept := w.observers[:0]
+
+	for _, fn := range w.observers {
+		if fn(frame.RGBA) {
+			kept = append(kept, fn)
+		}
+	}
+
+	w.observers = kept
+}
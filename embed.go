@@ -0,0 +1,193 @@
+package muon
+
+import (
+	"bytes"
+	"image"
+
+	. "github.com/ImVexed/muon/ultralight"
+)
+
+// Blit copies the pixels rendered by the last Pump into dst, a caller-owned premultiplied RGBA buffer with rows
+// stride bytes apart that still holds the previous frame. Only rows that differ are written, and dirty is called
+// with each changed band, so embedders only have to upload those regions. With Config.Adaptive the frame and the
+// dirty bands are at RenderScale of the Window's size. It reports false if nothing changed since the previous
+// Snapshot or Blit, or if dst is too small for the frame, in which case the frame is kept for the next call.
+// Like Pump it must be called from the OS thread that called New.
+func (w *Window) Blit(dst []byte, stride int, dirty func(image.Rectangle)) bool {
+	width, height := w.renderSize()
+
+	if !fits(dst, stride, int(width), int(height)) {
+		return false
+	}
+
+	frame, ok := w.Snapshot()
+
+	if !ok {
+		return false
+	}
+
+	defer frame.Close()
+
+	return blit(dst, stride, frame.RGBA, dirty)
+}
+
+// fits reports whether a buffer with rows stride bytes apart holds width × height pixels
+func fits(dst []byte, stride int, width int, height int) bool {
+	return stride >= width*4 && (height == 0 || len(dst) >= (height-1)*stride+width*4)
+}
+
+// blit copies the rows of src that differ from dst, see Blit
+func blit(dst []byte, stride int, src *image.RGBA, dirty func(image.Rectangle)) bool {
+	width, height := src.Rect.Dx(), src.Rect.Dy()
+
+	if !fits(dst, stride, width, height) {
+		return false
+	}
+
+	band := image.Rectangle{}
+
+	for y := 0; y < height; y++ {
+		s := src.Pix[y*src.Stride : y*src.Stride+width*4]
+		d := dst[y*stride : y*stride+width*4]
+
+		x0, x1 := changed(d, s)
+
+		if x0 == x1 {
+			if !band.Empty() && dirty != nil {
+				dirty(band)
+			}
+
+			band = image.Rectangle{}
+			continue
+		}
+
+		copy(d[x0:x1], s[x0:x1])
+
+		span := image.Rect(x0/4, y, x1/4, y+1)
+
+		if band.Empty() {
+			band = span
+		} else {
+			band = band.Union(span)
+		}
+	}
+
+	if !band.Empty() && dirty != nil {
+		dirty(band)
+	}
+
+	return true
+}
+
+// changed returns the byte range [from, to) of a row that differs between old and cur, aligned to
+// 64 pixel blocks which are compared with bytes.Equal
+func changed(old, cur []byte) (int, int) {
+	const block = 256
+
+	from, to := -1, 0
+
+	for i := 0; i < len(cur); i += block {
+		end := i + block
+
+		if end > len(cur) {
+			end = len(cur)
+		}
+
+		if bytes.Equal(old[i:end], cur[i:end]) {
+			continue
+		}
+
+		if from < 0 {
+			from = i
+		}
+
+		to = end
+	}
+
+	if from < 0 {
+		return 0, 0
+	}
+
+	return from, to
+}
+
+// MouseButton identifies a mouse button for input forwarding
+type MouseButton int
+
+const (
+	MouseNone MouseButton = iota
+	MouseLeft
+	MouseMiddle
+	MouseRight
+)
+
+// Modifier keys held during a key event
+const (
+	ModAlt uint32 = 1 << iota
+	ModCtrl
+	ModMeta
+	ModShift
+)
+
+// MouseMove forwards a mouse movement to the page, with button held if it is not MouseNone
+func (w *Window) MouseMove(x, y int, button MouseButton) {
+	w.mouse(KMouseEventType_MouseMoved, x, y, button)
+}
+
+// MouseDown forwards a mouse button press to the page
+func (w *Window) MouseDown(x, y int, button MouseButton) {
+	w.mouse(KMouseEventType_MouseDown, x, y, button)
+}
+
+// MouseUp forwards a mouse button release to the page
+func (w *Window) MouseUp(x, y int, button MouseButton) {
+	w.mouse(KMouseEventType_MouseUp, x, y, button)
+}
+
+func (w *Window) mouse(kind ULMouseEventType, x, y int, button MouseButton) {
+	w.post(func() {
+		// input arrives in Window coordinates, the view may be rendered at a reduced scale
+		scale := w.RenderScale()
+
+		evt := UlCreateMouseEvent(kind, int32(float64(x)*scale), int32(float64(y)*scale), ULMouseButton(button))
+		UlViewFireMouseEvent(w.view, evt)
+		UlDestroyMouseEvent(evt)
+	})
+}
+
+// Scroll forwards a scroll wheel movement of dx, dy pixels to the page
+func (w *Window) Scroll(dx, dy int) {
+	w.post(func() {
+		evt := UlCreateScrollEvent(KScrollEventType_ScrollByPixel, int32(dx), int32(dy))
+		UlViewFireScrollEvent(w.view, evt)
+		UlDestroyScrollEvent(evt)
+	})
+}
+
+// KeyDown forwards a key press, identified by its Windows virtual key code, to the page
+func (w *Window) KeyDown(key int, modifiers uint32) {
+	w.key(KKeyEventType_RawKeyDown, key, modifiers, "")
+}
+
+// KeyUp forwards a key release, identified by its Windows virtual key code, to the page
+func (w *Window) KeyUp(key int, modifiers uint32) {
+	w.key(KKeyEventType_KeyUp, key, modifiers, "")
+}
+
+// Type forwards text input to the page, one character event per rune
+func (w *Window) Type(text string) {
+	for _, r := range text {
+		w.key(KKeyEventType_Char, 0, 0, string(r))
+	}
+}
+
+func (w *Window) key(kind ULKeyEventType, key int, modifiers uint32, text string) {
+	w.post(func() {
+		str := UlCreateString(text)
+		defer UlDestroyString(str)
+
+		evt := UlCreateKeyEvent(kind, modifiers, int32(key), 0, str, str, false, false, false)
+		UlViewFireKeyEvent(w.view, evt)
+		UlDestroyKeyEvent(evt)
+	})
+}
@@ -0,0 +1,132 @@
+package muon
+
+import (
+	"reflect"
+	"sync"
+	"unsafe"
+
+	. "github.com/ImVexed/muon/ultralight"
+)
+
+// EmitMode decides how multiple payloads emitted on the same topic within one tick are coalesced
+type EmitMode int
+
+const (
+	// EmitLatest keeps only the most recent payload, listeners receive it as is
+	EmitLatest EmitMode = iota
+	// EmitAppend keeps every payload in order, listeners receive them as an array
+	EmitAppend
+)
+
+type eventBus struct {
+	mu      sync.Mutex
+	modes   map[string]EmitMode
+	pending map[string][]reflect.Value
+	spare   map[string][]reflect.Value
+	order   []string
+}
+
+// SetEmitMode changes how payloads emitted on topic are coalesced, topics default to EmitLatest
+func (w *Window) SetEmitMode(topic string, mode EmitMode) {
+	w.bus.mu.Lock()
+	defer w.bus.mu.Unlock()
+
+	if w.bus.modes == nil {
+		w.bus.modes = make(map[string]EmitMode)
+	}
+
+	w.bus.modes[topic] = mode
+}
+
+// Emit queues payload for the JS listeners registered with `muon.on(topic, fn)`. It is safe to call from any goroutine;
+// all topics emitted during a tick are coalesced and delivered to the page in a single dispatch on the next update.
+func (w *Window) Emit(topic string, payload interface{}) {
+	b := &w.bus
+	v := reflect.ValueOf(payload)
+
+	defer w.signal()
+
+	b.mu.Lock()
+	defer b.mu.Unlock()
+
+	if b.pending == nil {
+		b.pending = make(map[string][]reflect.Value)
+	}
+
+	vals, ok := b.pending[topic]
+
+	if !ok {
+		b.order = append(b.order, topic)
+	}
+
+	if b.modes[topic] == EmitAppend {
+		b.pending[topic] = append(vals, v)
+	} else if ok {
+		vals[0] = v
+	} else {
+		b.pending[topic] = []reflect.Value{v}
+	}
+}
+
+func (b *eventBus) busy() bool {
+	b.mu.Lock()
+	defer b.mu.Unlock()
+
+	return len(b.order) > 0
+}
+
+// flush delivers everything emitted since the last tick, must be called on the UI thread
+func (b *eventBus) flush(ctx JSContextRef) {
+	b.mu.Lock()
+
+	if len(b.order) == 0 {
+		b.mu.Unlock()
+		return
+	}
+
+	pending, order := b.pending, b.order
+	appended := make([]bool, len(order))
+
+	for i, topic := range order {
+		appended[i] = b.modes[topic] == EmitAppend
+	}
+
+	if b.spare == nil {
+		b.spare = make(map[string][]reflect.Value)
+	}
+
+	b.pending, b.spare = b.spare, nil
+	b.order = nil
+
+	b.mu.Unlock()
+
+	events := JSObjectMake(ctx, nil, nil)
+
+	for i, topic := range order {
+		var val JSValueRef
+
+		if appended[i] {
+			vals := make([]JSValueRef, len(pending[topic]))
+
+			for j, v := range pending[topic] {
+				vals[j] = toJSValue(ctx, v)
+			}
+
+			val = jsArray(ctx, vals)
+		} else {
+			val = toJSValue(ctx, pending[topic][len(pending[topic])-1])
+		}
+
+		name := JSStringCreateWithUTF8CString(topic)
+		JSObjectSetProperty(ctx, events, name, val, KJSPropertyAttributeNone, nil)
+		JSStringRelease(name)
+
+		delete(pending, topic)
+	}
+
+	b.mu.Lock()
+	b.spare = pending
+	b.mu.Unlock()
+
+	jsCall(ctx, []string{"muon", "dispatch"}, *(*JSValueRef)(unsafe.Pointer(&events)))
+}
@@ -0,0 +1,363 @@
+package muon
+
+import (
+	"bytes"
+	"compress/flate"
+	"encoding/binary"
+	"hash/adler32"
+	"hash/crc32"
+	"image"
+	"image/png"
+	"io"
+	"runtime"
+	"sync"
+)
+
+// unpremul[a<<8|c] is the straight alpha value of channel c premultiplied by alpha a
+var unpremul = func() []byte {
+	t := make([]byte, 256*256)
+
+	for a := 1; a < 256; a++ {
+		for c := 0; c <= a; c++ {
+			t[a<<8|c] = byte((c*255 + a/2) / a)
+		}
+
+		// values above alpha only come from broken input, clamp them
+		for c := a + 1; c < 256; c++ {
+			t[a<<8|c] = 255
+		}
+	}
+
+	return t
+}()
+
+// unpremultiplyRow converts a row of premultiplied RGBA pixels to straight alpha. Runs of opaque or fully transparent
+// pixels are detected two at a time and copied as is.
+func unpremultiplyRow(dst, src []byte) {
+	i, n := 0, len(dst)&^3
+
+	for ; i+8 <= n; i += 8 {
+		v := binary.LittleEndian.Uint64(src[i:])
+
+		if a := v & 0xff000000ff000000; a == 0xff000000ff000000 || v == 0 {
+			binary.LittleEndian.PutUint64(dst[i:], v)
+			continue
+		}
+
+		unpremultiplyPixel(dst[i:i+4], src[i:i+4])
+		unpremultiplyPixel(dst[i+4:i+8], src[i+4:i+8])
+	}
+
+	for ; i < n; i += 4 {
+		unpremultiplyPixel(dst[i:i+4], src[i:i+4])
+	}
+}
+
+func unpremultiplyPixel(dst, src []byte) {
+	a := int(src[3])
+
+	switch a {
+	case 255:
+		copy(dst, src[:4])
+	case 0:
+		dst[0], dst[1], dst[2], dst[3] = 0, 0, 0, 0
+	default:
+		t := unpremul[a<<8 : a<<8+256]
+		dst[0], dst[1], dst[2], dst[3] = t[src[0]], t[src[1]], t[src[2]], byte(a)
+	}
+}
+
+// parallel splits [0, n) into contiguous ranges and runs fn on each from its own goroutine
+func parallel(n int, fn func(from, to int)) {
+	workers := runtime.GOMAXPROCS(0)
+
+	if workers > n {
+		workers = n
+	}
+
+	if workers <= 1 {
+		fn(0, n)
+		return
+	}
+
+	var wg sync.WaitGroup
+
+	for i := 0; i < workers; i++ {
+		from, to := n*i/workers, n*(i+1)/workers
+
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			fn(from, to)
+		}()
+	}
+
+	wg.Wait()
+}
+
+// Unpremultiply converts a premultiplied image, such as a Frame, into a straight alpha image with tightly packed rows,
+// reusing dst's buffer when it is large enough. Rows are converted in parallel.
+func Unpremultiply(dst *image.NRGBA, src *image.RGBA) *image.NRGBA {
+	r := src.Rect
+	w, h := r.Dx(), r.Dy()
+
+	if dst == nil || cap(dst.Pix) < w*h*4 {
+		dst = image.NewNRGBA(image.Rect(0, 0, w, h))
+	} else {
+		dst.Pix, dst.Stride, dst.Rect = dst.Pix[:w*h*4], w*4, image.Rect(0, 0, w, h)
+	}
+
+	parallel(h, func(from, to int) {
+		for y := from; y < to; y++ {
+			s := src.PixOffset(r.Min.X, r.Min.Y+y)
+			unpremultiplyRow(dst.Pix[y*dst.Stride:(y+1)*dst.Stride], src.Pix[s:s+w*4])
+		}
+	})
+
+	return dst
+}
+
+// EncodeRaw writes img as straight alpha RGBA with tightly packed rows and no header
+func EncodeRaw(w io.Writer, img *image.RGBA) error {
+	r := img.Rect
+	row := r.Dx() * 4
+	const strip = 64
+
+	bufs := make([][]byte, (r.Dy()+strip-1)/strip)
+
+	parallel(len(bufs), func(from, to int) {
+		for i := from; i < to; i++ {
+			y0, y1 := i*strip, (i+1)*strip
+
+			if y1 > r.Dy() {
+				y1 = r.Dy()
+			}
+
+			buf := make([]byte, (y1-y0)*row)
+
+			for y := y0; y < y1; y++ {
+				s := img.PixOffset(r.Min.X, r.Min.Y+y)
+				unpremultiplyRow(buf[(y-y0)*row:(y-y0+1)*row], img.Pix[s:s+row])
+			}
+
+			bufs[i] = buf
+		}
+	})
+
+	for _, buf := range bufs {
+		if _, err := w.Write(buf); err != nil {
+			return err
+		}
+	}
+
+	return nil
+}
+
+// EncodePNG writes img as a PNG, compressing horizontal strips of the image on all cores at once.
+// Premultiplied images are converted to straight alpha on the fly; images other than *image.RGBA and
+// *image.NRGBA are handed to image/png.
+func EncodePNG(w io.Writer, img image.Image) error {
+	var pix []byte
+	var stride int
+	var premultiplied bool
+
+	switch img := img.(type) {
+	case *image.RGBA:
+		pix, stride, premultiplied = img.Pix[img.PixOffset(img.Rect.Min.X, img.Rect.Min.Y):], img.Stride, true
+	case *image.NRGBA:
+		pix, stride = img.Pix[img.PixOffset(img.Rect.Min.X, img.Rect.Min.Y):], img.Stride
+	default:
+		return png.Encode(w, img)
+	}
+
+	width, height := img.Bounds().Dx(), img.Bounds().Dy()
+
+	if width == 0 || height == 0 {
+		return png.Encode(w, img)
+	}
+
+	row := width * 4
+
+	// strips are large enough for deflate to find its matches and small enough to spread across every core
+	rows := (256 * 1024) / (row + 1)
+
+	if rows < 16 {
+		rows = 16
+	}
+
+	strips := make([]pngStrip, (height+rows-1)/rows)
+
+	var failed error
+	var mu sync.Mutex
+
+	parallel(len(strips), func(from, to int) {
+		for i := from; i < to; i++ {
+			y0, y1 := i*rows, (i+1)*rows
+
+			if y1 > height {
+				y1 = height
+			}
+
+			err := strips[i].encode(pix, stride, row, y0, y1, premultiplied, i == len(strips)-1)
+
+			if err != nil {
+				mu.Lock()
+				failed = err
+				mu.Unlock()
+			}
+		}
+	})
+
+	if failed != nil {
+		return failed
+	}
+
+	var adler uint32 = 1
+
+	for _, s := range strips {
+		adler = adler32Combine(adler, s.adler, s.n)
+	}
+
+	bw := &pngWriter{w: w}
+
+	bw.write([]byte("\x89PNG\r\n\x1a\n"))
+
+	var ihdr [13]byte
+	binary.BigEndian.PutUint32(ihdr[0:], uint32(width))
+	binary.BigEndian.PutUint32(ihdr[4:], uint32(height))
+	ihdr[8] = 8 // bit depth
+	ihdr[9] = 6 // truecolor with alpha
+	bw.chunk("IHDR", ihdr[:])
+
+	// zlib header for deflate with a 32K window, checked so header%31 == 0
+	bw.chunk("IDAT", []byte{0x78, 0x01})
+
+	for _, s := range strips {
+		bw.chunk("IDAT", s.data)
+	}
+
+	var sum [4]byte
+	binary.BigEndian.PutUint32(sum[:], adler)
+	bw.chunk("IDAT", sum[:])
+
+	bw.chunk("IEND", nil)
+
+	return bw.err
+}
+
+type pngStrip struct {
+	data  []byte
+	adler uint32
+	n     int64
+}
+
+// encode filters and compresses rows [y0, y1). Every strip but the last ends on a byte aligned sync flush,
+// so the compressed strips concatenate into a single valid deflate stream.
+func (s *pngStrip) encode(pix []byte, stride, row, y0, y1 int, premultiplied, last bool) error {
+	var buf bytes.Buffer
+
+	fw, err := flate.NewWriter(&buf, flate.DefaultCompression)
+
+	if err != nil {
+		return err
+	}
+
+	line := make([]byte, 1+row)
+	cur := make([]byte, row)
+
+	sum := adler32.New()
+
+	for y := y0; y < y1; y++ {
+		src := pix[y*stride : y*stride+row]
+
+		if premultiplied {
+			unpremultiplyRow(cur, src)
+		} else {
+			copy(cur, src)
+		}
+
+		// Sub filter: each byte minus the same channel of the pixel to its left
+		line[0] = 1
+		copy(line[1:5], cur[:4])
+
+		for i := 4; i < row; i++ {
+			line[1+i] = cur[i] - cur[i-4]
+		}
+
+		sum.Write(line)
+		s.n += int64(len(line))
+
+		if _, err := fw.Write(line); err != nil {
+			return err
+		}
+	}
+
+	if last {
+		err = fw.Close()
+	} else {
+		err = fw.Flush()
+	}
+
+	s.data = buf.Bytes()
+	s.adler = sum.Sum32()
+
+	return err
+}
+
+const adlerBase = 65521
+
+// adler32Combine returns the Adler-32 checksum of two concatenated blocks given the checksum of each and the second's length
+func adler32Combine(adler1, adler2 uint32, len2 int64) uint32 {
+	rem := uint32(len2 % adlerBase)
+	s1 := adler1 & 0xffff
+	s2 := rem * s1 % adlerBase
+
+	s1 += (adler2 & 0xffff) + adlerBase - 1
+	s2 += (adler1 >> 16) + (adler2 >> 16) + adlerBase - rem
+
+	if s1 >= adlerBase {
+		s1 -= adlerBase
+	}
+
+	if s1 >= adlerBase {
+		s1 -= adlerBase
+	}
+
+	if s2 >= adlerBase<<1 {
+		s2 -= adlerBase << 1
+	}
+
+	if s2 >= adlerBase {
+		s2 -= adlerBase
+	}
+
+	return s2<<16 | s1
+}
+
+type pngWriter struct {
+	w   io.Writer
+	err error
+}
+
+func (p *pngWriter) write(b []byte) {
+	if p.err == nil {
+		_, p.err = p.w.Write(b)
+	}
+}
+
+func (p *pngWriter) chunk(name string, data []byte) {
+	var header [8]byte
+	binary.BigEndian.PutUint32(header[:4], uint32(len(data)))
+	copy(header[4:], name)
+
+	crc := crc32.NewIEEE()
+	crc.Write(header[4:])
+	crc.Write(data)
+
+	var sum [4]byte
+	binary.BigEndian.PutUint32(sum[:], crc.Sum32())
+
+	p.write(header[:])
+	p.write(data)
+	p.write(sum[:])
+}
@@ -0,0 +1,378 @@
+package muon
+
+import (
+	"bytes"
+	"errors"
+	"image"
+	"runtime"
+	"sync"
+	"time"
+
+	. "github.com/ImVexed/muon/ultralight"
+)
+
+// WaitCondition decides when a RenderJob's page is ready to be captured
+type WaitCondition int
+
+const (
+	// WaitLoaded captures once the page and all its resources have finished loading
+	WaitLoaded WaitCondition = iota
+	// WaitDOMReady captures as soon as the DOM has been parsed, without waiting for images
+	WaitDOMReady
+)
+
+// ErrRenderTimeout is reported for a RenderJob whose page did not become ready within its Timeout
+var ErrRenderTimeout = errors.New("page did not become ready in time")
+
+// RenderJob describes a page to be rendered by a RenderFarm, either HTML or URL must be set
+type RenderJob struct {
+	HTML   string
+	URL    string
+	Width  uint32
+	Height uint32
+
+	WaitFor WaitCondition
+	// Settle is extra time given to the page after WaitFor is met, e.g. for scripts drawing charts
+	Settle time.Duration
+	// Timeout fails the job if the page is not ready in time, defaults to 30s
+	Timeout time.Duration
+	// Raw returns straight alpha RGBA rows instead of a PNG
+	Raw bool
+}
+
+// RenderResult is the outcome of a RenderJob
+type RenderResult struct {
+	Job   *RenderJob
+	Image []byte
+	Err   error
+	// Width and Height are the size that was rendered, with the job's defaults applied
+	Width  uint32
+	Height uint32
+}
+
+// RenderFarm renders batches of pages to images. Ultralight supports a single renderer per process, so the farm
+// drives many views from one renderer on a dedicated OS thread while encoding finished captures on every core.
+// A RenderFarm cannot be used in the same process as a Window, and only one can run at a time.
+// Pages are rendered as plain web pages: the muon runtime, bindings and everything else a Window injects are not
+// available to them.
+type RenderFarm struct {
+	jobs     chan *RenderJob
+	captured chan capture
+	results  chan *RenderResult
+	closing  sync.Once
+	encoders sync.WaitGroup
+
+	// finished queues encoded results until they are received, so rendering never waits on the caller
+	mu       sync.Mutex
+	queued   *sync.Cond
+	finished []*RenderResult
+	encoded  bool
+}
+
+type capture struct {
+	job *RenderJob
+	img *image.RGBA
+	err error
+}
+
+type farmView struct {
+	view     ULView
+	job      *RenderJob
+	width    uint32
+	height   uint32
+	started  time.Time
+	ready    time.Time
+	loaded   bool
+	domReady bool
+}
+
+// NewRenderFarm starts a RenderFarm rendering up to views pages at once, or two per CPU if views is 0.
+// Engine settings are taken from cfg, which may be nil.
+func NewRenderFarm(views int, cfg *Config) *RenderFarm {
+	if views <= 0 {
+		views = 2 * runtime.NumCPU()
+	}
+
+	if cfg == nil {
+		cfg = &Config{}
+	}
+
+	claimEngine("a RenderFarm")
+
+	f := &RenderFarm{
+		jobs:     make(chan *RenderJob),
+		captured: make(chan capture, views),
+		results:  make(chan *RenderResult),
+	}
+
+	f.queued = sync.NewCond(&f.mu)
+
+	for i := 0; i < runtime.NumCPU(); i++ {
+		f.encoders.Add(1)
+		go f.encode()
+	}
+
+	go func() {
+		f.encoders.Wait()
+
+		f.mu.Lock()
+		f.encoded = true
+		f.queued.Broadcast()
+		f.mu.Unlock()
+	}()
+
+	go f.deliver()
+
+	go f.render(views, cfg)
+
+	return f
+}
+
+// Submit queues job, blocking while every view is busy
+func (f *RenderFarm) Submit(job *RenderJob) {
+	f.jobs <- job
+}
+
+// Results returns the channel every RenderResult is delivered on, in order of completion.
+// It is closed once the farm has been closed and all submitted jobs are done. Results are queued until they are
+// received, so a batch may be submitted in full before draining it, at the cost of holding its images in memory.
+func (f *RenderFarm) Results() <-chan *RenderResult {
+	return f.results
+}
+
+// Close stops accepting jobs, jobs already submitted are still rendered
+func (f *RenderFarm) Close() {
+	f.closing.Do(func() {
+		close(f.jobs)
+	})
+}
+
+func (f *RenderFarm) render(n int, cfg *Config) {
+	runtime.LockOSThread()
+	defer runtime.UnlockOSThread()
+
+	defer close(f.captured)
+	defer releaseEngine()
+
+	renderer := UlCreateRenderer(cfg.engine())
+	defer UlDestroyRenderer(renderer)
+
+	slots := make([]*farmView, n)
+	idle := make([]*farmView, 0, n)
+
+	for i := range slots {
+		v := &farmView{width: 1, height: 1}
+		v.view = UlCreateView(renderer, v.width, v.height, false)
+
+		registerView(v.view, &viewEvents{
+			domReady: func() {
+				v.domReady = true
+			},
+			finishLoading: func() {
+				v.loaded = true
+			},
+		})
+
+		slots[i] = v
+		idle = append(idle, v)
+	}
+
+	defer func() {
+		for _, v := range slots {
+			unregisterView(v.view)
+			UlDestroyView(v.view)
+		}
+	}()
+
+	jobs := f.jobs
+	ticker := time.NewTicker(4 * time.Millisecond)
+	defer ticker.Stop()
+
+	for jobs != nil || len(idle) < n {
+		// only accept jobs while a view is free, and only tick while one is busy
+		accept, tick := jobs, ticker.C
+
+		if len(idle) == 0 {
+			accept = nil
+		}
+
+		if len(idle) == n {
+			tick = nil
+		}
+
+		select {
+		case job, ok := <-accept:
+			if !ok {
+				jobs = nil
+				continue
+			}
+
+			v := idle[len(idle)-1]
+			idle = idle[:len(idle)-1]
+
+			v.start(job)
+		case <-tick:
+		}
+
+		UlUpdate(renderer)
+
+		var ready []*farmView
+		now := time.Now()
+
+		for _, v := range slots {
+			if v.job == nil {
+				continue
+			}
+
+			switch v.poll(now) {
+			case pollReady:
+				ready = append(ready, v)
+			case pollTimeout:
+				f.captured <- capture{job: v.job, err: ErrRenderTimeout}
+				v.job = nil
+				idle = append(idle, v)
+			}
+		}
+
+		if len(ready) == 0 {
+			continue
+		}
+
+		UlRender(renderer)
+
+		for _, v := range ready {
+			f.captured <- v.capture()
+			v.job = nil
+			idle = append(idle, v)
+		}
+	}
+}
+
+// start loads job into the view, resizing it only when the size changed
+func (v *farmView) start(job *RenderJob) {
+	width, height := job.Width, job.Height
+
+	if width == 0 {
+		width = 1024
+	}
+
+	if height == 0 {
+		height = 768
+	}
+
+	if width != v.width || height != v.height {
+		UlViewResize(v.view, width, height)
+		v.width, v.height = width, height
+	}
+
+	v.job = job
+	v.started = time.Now()
+	v.ready = time.Time{}
+	v.loaded, v.domReady = false, false
+
+	if job.URL != "" {
+		url := UlCreateString(job.URL)
+		UlViewLoadURL(v.view, url)
+		UlDestroyString(url)
+		return
+	}
+
+	html := UlCreateString(job.HTML)
+	UlViewLoadHTML(v.view, html)
+	UlDestroyString(html)
+}
+
+const (
+	pollWaiting = iota
+	pollReady
+	pollTimeout
+)
+
+// poll reports whether the view's job is ready to be captured at now, has timed out or is still waiting
+func (v *farmView) poll(now time.Time) int {
+	if v.ready.IsZero() && (v.loaded || (v.domReady && v.job.WaitFor == WaitDOMReady)) {
+		v.ready = now
+	}
+
+	timeout := v.job.Timeout
+
+	if timeout <= 0 {
+		timeout = 30 * time.Second
+	}
+
+	switch {
+	case !v.ready.IsZero() && now.Sub(v.ready) >= v.job.Settle:
+		return pollReady
+	case now.Sub(v.started) > timeout:
+		return pollTimeout
+	}
+
+	return pollWaiting
+}
+
+// capture copies the view's pixels so the view can take the next job while they are encoded
+func (v *farmView) capture() capture {
+	bitmap := UlViewGetBitmap(v.view)
+
+	if bitmap == nil || UlBitmapIsEmpty(bitmap) || UlBitmapGetFormat(bitmap) != KBitmapFormat_RGBA8 {
+		return capture{job: v.job, err: errors.New("view has no bitmap")}
+	}
+
+	img := copyRGBA(nil, lockRGBA(bitmap))
+	UlBitmapUnlockPixels(bitmap)
+
+	return capture{job: v.job, img: img}
+}
+
+func (f *RenderFarm) encode() {
+	defer f.encoders.Done()
+
+	for c := range f.captured {
+		res := &RenderResult{Job: c.job, Err: c.err}
+
+		if c.err == nil {
+			var buf bytes.Buffer
+
+			size := c.img.Bounds().Size()
+			res.Width, res.Height = uint32(size.X), uint32(size.Y)
+
+			if c.job.Raw {
+				res.Err = EncodeRaw(&buf, c.img)
+			} else {
+				res.Err = EncodePNG(&buf, c.img)
+			}
+
+			res.Image = buf.Bytes()
+		}
+
+		f.mu.Lock()
+		f.finished = append(f.finished, res)
+		f.queued.Signal()
+		f.mu.Unlock()
+	}
+}
+
+// deliver hands queued results to Results in order, closing it once every encoder is done
+func (f *RenderFarm) deliver() {
+	defer close(f.results)
+
+	for {
+		f.mu.Lock()
+
+		for len(f.finished) == 0 && !f.encoded {
+			f.queued.Wait()
+		}
+
+		if len(f.finished) == 0 {
+			f.mu.Unlock()
+			return
+		}
+
+		res := f.finished[0]
+		f.finished[0] = nil
+		f.finished = f.finished[1:]
+		f.mu.Unlock()
+
+		f.results <- res
+	}
+}
@@ -0,0 +1,244 @@
+package muon
+
+import (
+	"container/list"
+	"context"
+	"encoding/json"
+	"reflect"
+	"strconv"
+	"sync"
+	"sync/atomic"
+	"time"
+)
+
+// Memoize caches the binding's results keyed by its decoded arguments, keeping at most size entries for up to ttl
+// (0 for no limit). Concurrent identical calls to an Async binding share a single execution of the Go function.
+func Memoize(size int, ttl time.Duration) BindOption {
+	return func(f *ipf) {
+		f.memo = &memo{
+			size:    size,
+			ttl:     ttl,
+			entries: make(map[string]*list.Element),
+			lru:     list.New(),
+			flights: make(map[string]*flight),
+		}
+	}
+}
+
+// Invalidate drops the cached result of the named Memoize binding for the given arguments, or every cached result if none are given
+func (w *Window) Invalidate(name string, args ...interface{}) {
+	f, ok := w.binding(name)
+
+	if !ok || f.memo == nil {
+		return
+	}
+
+	if len(args) == 0 {
+		f.memo.clear()
+		return
+	}
+
+	params := make([]reflect.Value, len(args))
+
+	for i, arg := range args {
+		params[i] = reflect.ValueOf(arg)
+	}
+
+	if key, ok := memoKey(params); ok {
+		f.memo.invalidate(key)
+	}
+}
+
+type memo struct {
+	size int
+	ttl  time.Duration
+
+	mu      sync.Mutex
+	gen     uint64
+	entries map[string]*list.Element
+	lru     *list.List
+	flights map[string]*flight
+}
+
+type memoEntry struct {
+	key     string
+	val     []reflect.Value
+	expires time.Time
+}
+
+type flight struct {
+	gen     uint64
+	waiters []func([]reflect.Value, error)
+}
+
+// memoKey derives a cache key from decoded arguments, reporting false if they cannot be encoded
+func memoKey(params []reflect.Value) (string, bool) {
+	args := make([]interface{}, len(params))
+
+	for i, p := range params {
+		args[i] = p.Interface()
+	}
+
+	key, err := json.Marshal(args)
+
+	if err != nil {
+		return "", false
+	}
+
+	return string(key), true
+}
+
+func (m *memo) get(key string) ([]reflect.Value, bool) {
+	m.mu.Lock()
+	defer m.mu.Unlock()
+
+	return m.getLocked(key)
+}
+
+func (m *memo) getLocked(key string) ([]reflect.Value, bool) {
+	el, ok := m.entries[key]
+
+	if !ok {
+		return nil, false
+	}
+
+	e := el.Value.(*memoEntry)
+
+	if m.ttl > 0 && time.Now().After(e.expires) {
+		m.lru.Remove(el)
+		delete(m.entries, key)
+		return nil, false
+	}
+
+	m.lru.MoveToFront(el)
+
+	return e.val, true
+}
+
+func (m *memo) putLocked(key string, val []reflect.Value) {
+	e := &memoEntry{
+		key:     key,
+		val:     val,
+		expires: time.Now().Add(m.ttl),
+	}
+
+	if el, ok := m.entries[key]; ok {
+		el.Value = e
+		m.lru.MoveToFront(el)
+		return
+	}
+
+	m.entries[key] = m.lru.PushFront(e)
+
+	for m.size > 0 && m.lru.Len() > m.size {
+		oldest := m.lru.Back()
+		m.lru.Remove(oldest)
+		delete(m.entries, oldest.Value.(*memoEntry).key)
+	}
+}
+
+func (m *memo) invalidate(key string) {
+	m.mu.Lock()
+	defer m.mu.Unlock()
+
+	m.gen++
+
+	if el, ok := m.entries[key]; ok {
+		m.lru.Remove(el)
+		delete(m.entries, key)
+	}
+}
+
+func (m *memo) clear() {
+	m.mu.Lock()
+	defer m.mu.Unlock()
+
+	m.gen++
+	m.entries = make(map[string]*list.Element)
+	m.lru.Init()
+}
+
+// call returns the cached result for params or invokes the function inline and caches its result
+func (m *memo) call(f *ipf, gctx context.Context, params []reflect.Value) []reflect.Value {
+	key, ok := memoKey(params)
+
+	if !ok {
+		return f.invoke(gctx, params)
+	}
+
+	if val, ok := m.get(key); ok {
+		atomic.AddUint64(&f.stats.Hits, 1)
+		return val
+	}
+
+	m.mu.Lock()
+	gen := m.gen
+	m.mu.Unlock()
+
+	val := f.invoke(gctx, params)
+
+	m.mu.Lock()
+	if gen == m.gen {
+		m.putLocked(key, val)
+	}
+	m.mu.Unlock()
+
+	return val
+}
+
+// do hands cb the cached result for params, or runs fn on a new goroutine, sharing that execution with every
+// identical call made by the same page generation before it finishes. fn runs under the page's context pctx, a
+// result produced after it was cancelled is handed to the waiters but not cached.
+func (m *memo) do(f *ipf, page uint64, pctx context.Context, params []reflect.Value, fn func() ([]reflect.Value, error), cb func([]reflect.Value, error)) {
+	key, ok := memoKey(params)
+
+	if !ok {
+		go func() {
+			cb(fn())
+		}()
+		return
+	}
+
+	// a flight is cancelled with the page that started it, so callers from a later page must not join it
+	fkey := strconv.FormatUint(page, 10) + "\x00" + key
+
+	m.mu.Lock()
+
+	if val, ok := m.getLocked(key); ok {
+		m.mu.Unlock()
+		atomic.AddUint64(&f.stats.Hits, 1)
+		cb(val, nil)
+		return
+	}
+
+	if fl, ok := m.flights[fkey]; ok {
+		fl.waiters = append(fl.waiters, cb)
+		m.mu.Unlock()
+		atomic.AddUint64(&f.stats.Hits, 1)
+		return
+	}
+
+	fl := &flight{
+		gen:     m.gen,
+		waiters: []func([]reflect.Value, error){cb},
+	}
+	m.flights[fkey] = fl
+
+	m.mu.Unlock()
+
+	go func() {
+		val, err := fn()
+
+		m.mu.Lock()
+		delete(m.flights, fkey)
+
+		if err == nil && fl.gen == m.gen && pctx.Err() == nil {
+			m.putLocked(key, val)
+		}
+		m.mu.Unlock()
+
+		for _, cb := range fl.waiters {
+			cb(val, err)
+		}
+	}()
+}
@@ -1,11 +1,17 @@
 package muon
 
 import (
+	"context"
 	"encoding/json"
 	"errors"
+	"image"
 	"net"
 	"net/http"
 	"reflect"
+	"runtime"
+	"sync"
+	"sync/atomic"
+	"time"
 	"unsafe"
 
 	. "github.com/ImVexed/muon/ultralight"
@@ -13,18 +19,65 @@ import (
 
 // Window represents a single Ultralight instance
 type Window struct {
+	// virtual is the virtual clock in nanoseconds, accessed atomically and kept first for 64-bit alignment on 32-bit platforms
+	virtual int64
+
 	wnd       ULWindow
 	ov        ULOverlay
 	view      ULView
 	app       ULApp
+	renderer  ULRenderer
 	handler   http.Handler
 	cfg       *Config
 	callbacks map[string]*ipf
+
+	mu     sync.Mutex
+	tasks  []func()
+	wake   chan struct{}
+	hidden int32
+	power  PowerPolicy
+	scaler scaler
+	born   time.Time
+
+	assetErr error
+
+	observers []func(*image.RGBA) bool
+	scripts   []script
+	streams   map[string]*stream
+	syncs     map[string]*Synced
+	bus       eventBus
+	patch     Patch
+
+	global   JSGlobalContextRef
+	pages    uint64
+	life     context.Context
+	quit     context.CancelFunc
+	page     context.Context
+	leave    context.CancelFunc
+	inflight map[call]context.CancelFunc
+	awaits   map[float64]*awaiting
+	awaitSeq float64
 }
 
 type ipf struct {
+	// stats is accessed atomically and kept first for 64-bit alignment on 32-bit platforms
+	stats BindStats
+
 	Function   reflect.Value
 	ParamTypes []reflect.Type
+
+	batched  bool
+	async    bool
+	context  bool
+	limit    string
+	interval time.Duration
+	memo     *memo
+	raw      func(ctx JSContextRef, args []JSValueRef) JSValueRef
+}
+
+type script struct {
+	key string
+	js  string
 }
 
 // Config contains configurable controls for the Ultralight engine
@@ -39,18 +92,122 @@ type Config struct {
 	Borderless  bool
 	Titled      bool
 	Maximizable bool
+
+	// Headless renders into an offscreen view without creating a native window, frames are
+	// produced by Start's own loop or by calling Tick or Pump
+	Headless bool
+
+	// Power lowers the frame rate of a headless Window while it is hidden
+	Power PowerPolicy
+
+	// Adaptive enables dynamic render resolution for headless Windows
+	Adaptive *AdaptiveResolution
+
+	// FileSystem serves pages starting at /index.html. An http.Dir is read straight from the engine's file system
+	// instead of through the handler on a loopback socket; the handler and Cache are not used then. Any other file
+	// system, and any file system on a headless Window, is served over the socket, through the handler if there is
+	// one.
+	FileSystem http.FileSystem
+
+	// Cache puts an in-memory response cache with ETags and gzip in front of the handler, see Cached
+	Cache *CacheConfig
+
+	// VirtualTime gives a headless Window's pages a clock, timers and animation frames that only move when Advance
+	// is called, or in step with the frame loop started by Start. CSS animations still run on the engine's clock.
+	VirtualTime bool
+
+	// Profile picks a preset for the engine settings below and Power, fields set explicitly take precedence
+	Profile Profile
+	// MemoryCacheSize caps the engine's resource cache in bytes
+	MemoryCacheSize uint32
+	// PageCacheSize is the number of pages kept for back/forward navigation
+	PageCacheSize uint32
+	// AnimationTimerDelay is the time between animation frames, defaults to 1/60s
+	AnimationTimerDelay time.Duration
+	// ForceRepaint repaints the whole view every frame instead of only what changed
+	ForceRepaint bool
+	// DisableImages stops images from being loaded
+	DisableImages bool
+	// DeviceScale hints the device scale factor, e.g. 2.0 for HiDPI displays
+	DeviceScale float64
+	// UserStylesheet is CSS applied to every page
+	UserStylesheet string
+}
+
+// engineLock records what holds the process's Ultralight renderer, the library supports only one per process
+var engineLock struct {
+	sync.Mutex
+	owner string
 }
 
-// New creates a Ultralight Window
+// claimEngine reserves the renderer for owner, panicking if a Window or RenderFarm already holds it
+func claimEngine(owner string) {
+	engineLock.Lock()
+	defer engineLock.Unlock()
+
+	if engineLock.owner != "" {
+		panic("Ultralight supports a single renderer per process, it is already used by " + engineLock.owner)
+	}
+
+	engineLock.owner = owner
+}
+
+func releaseEngine() {
+	engineLock.Lock()
+	engineLock.owner = ""
+	engineLock.Unlock()
+}
+
+// New creates a Ultralight Window. Ultralight supports a single renderer per process, so only one Window can be
+// created and not alongside a RenderFarm. A headless Window's renderer is bound to the OS thread that created it, so
+// New locks the calling goroutine to its thread and Start, Load, Pump, Tick and Advance must be called from it.
 func New(cfg *Config, handler http.Handler) *Window {
+	if cfg.Headless {
+		claimEngine("a headless Window")
+	} else {
+		claimEngine("a Window")
+	}
+
 	w := &Window{
 		cfg:       cfg,
 		handler:   handler,
 		callbacks: make(map[string]*ipf),
+		streams:   make(map[string]*stream),
+		inflight:  make(map[call]context.CancelFunc),
+		awaits:    make(map[float64]*awaiting),
+	}
+
+	w.life, w.quit = context.WithCancel(context.Background())
+	w.page, w.leave = context.WithCancel(w.life)
+
+	w.born = time.Now()
+	w.wake = make(chan struct{}, 1)
+	w.patch.wake = w.signal
+
+	ufg := cfg.engine()
+	w.power = cfg.resolve().power
+
+	if cfg.VirtualTime && !cfg.Headless {
+		panic("VirtualTime requires a headless Window")
+	}
+
+	if cfg.Headless {
+		runtime.LockOSThread()
+
+		w.renderer = UlCreateRenderer(ufg)
+		w.view = UlCreateView(w.renderer, w.cfg.Width, w.cfg.Height, false)
+
+		w.setup()
+
+		return w
 	}
 
-	ufg := UlCreateConfig()
 	std := UlCreateSettings()
+
+	if cfg.FileSystem != nil {
+		w.mountAssets(std)
+	}
+
 	w.app = UlCreateApp(std, ufg)
 	mm := UlAppGetMainMonitor(w.app)
 
@@ -82,27 +239,49 @@ func New(cfg *Config, handler http.Handler) *Window {
 	w.ov = UlCreateOverlay(w.wnd, w.cfg.Width, w.cfg.Height, w.cfg.X, w.cfg.Y)
 
 	UlWindowSetResizeCallback(w.wnd, resizeCallback(w.ov), nil)
+	UlWindowSetCloseCallback(w.wnd, w.close, nil)
 
 	w.view = UlOverlayGetView(w.ov)
+	w.renderer = UlAppGetRenderer(w.app)
+
+	UlAppSetUpdateCallback(w.app, w.update, nil)
+
+	w.setup()
 
 	return w
 }
 
-// Start sets up the Ultralight runtime and begins showing the Window
-func (w *Window) Start() error {
+// setup hooks the view up to the bridge
+func (w *Window) setup() {
+	registerView(w.view, &viewEvents{
+		beginLoading: w.beginLoading,
+		domReady:     w.domReady,
+	})
 
-	addr, err := serveHandler(w.handler)
+	w.inject("runtime", runtimeJS)
 
-	if err != nil {
-		return err
+	if w.cfg.VirtualTime {
+		w.inject("clock", clockJS)
 	}
 
-	url := UlCreateString(addr)
-	defer UlDestroyString(url)
+	w.Bind("__muon:abort", w.abort)
+	w.bindRaw("__muon:settle", w.settleAwait)
+}
 
-	UlViewLoadURL(w.view, url)
+// Start sets up the Ultralight runtime and begins showing the Window.
+// A headless Window is driven by a frame loop until Stop is called, on the goroutine that called New.
+func (w *Window) Start() error {
+	if err := w.load(); err != nil {
+		return err
+	}
 
-	UlAppRun(w.app)
+	if w.cfg.Headless {
+		w.run()
+	} else {
+		UlAppRun(w.app)
+	}
+
+	w.quit()
 
 	return nil
 }
@@ -110,26 +289,36 @@ func (w *Window) Start() error {
 var registerCount int
 
 // Bind registers the given function to the given name in the Window's JS global object
-func (w *Window) Bind(name string, function interface{}) {
-	f := &ipf{
-		Function: reflect.ValueOf(function),
+func (w *Window) Bind(name string, function interface{}, opts ...BindOption) {
+	f := newIPF(name, function, opts)
+
+	if f.context {
+		f.async = true
 	}
 
-	t := f.Function.Type()
+	if f.batched {
+		f.async = false
+	}
 
-	f.ParamTypes = make([]reflect.Type, t.NumIn())
+	native := nativeName(name)
 
-	for i := 0; i < t.NumIn(); i++ {
-		f.ParamTypes[i] = t.In(i)
+	w.mu.Lock()
+	if f.stubbed() {
+		delete(w.callbacks, name)
+		w.callbacks[native] = f
+	} else {
+		delete(w.callbacks, native)
+		w.callbacks[name] = f
 	}
+	w.mu.Unlock()
 
-	if t.NumOut() > 1 {
-		panic("Too many return values!")
+	if f.stubbed() {
+		w.addFunction(native)
+		w.inject("bind:"+name, f.stub(name, native))
+	} else {
+		w.uninject("bind:" + name)
+		w.addFunction(name)
 	}
-
-	w.callbacks[name] = f
-
-	w.addFunction(name)
 }
 
 // Eval evaluates a given JavaScript string in the given Window view. `ret` is necessary for JSON serialization if an object is returned.
@@ -151,53 +340,244 @@ func (w *Window) Eval(js string, ret reflect.Type) (interface{}, error) {
 
 // Resize changes the given Window's size
 func (w *Window) Resize(width int, height int) {
+	if w.cfg.Headless {
+		w.cfg.Width, w.cfg.Height = uint32(width), uint32(height)
+
+		if w.cfg.Adaptive != nil {
+			w.rescale()
+		} else {
+			UlViewResize(w.view, w.cfg.Width, w.cfg.Height)
+		}
+		return
+	}
+
 	UlOverlayResize(w.ov, uint32(width), uint32(height))
 }
 
 // Move sets the Window's position to the given coordinates
 func (w *Window) Move(x int, y int) {
+	if w.cfg.Headless {
+		return
+	}
+
 	UlOverlayMoveTo(w.ov, int32(x), int32(y))
 }
 
-func (w *Window) ipcCallback(ctx JSContextRef, functin JSObjectRef, thisObject JSObjectRef, argumentCount uint, arguments []JSValueRef, exception []JSValueRef) JSValueRef {
-	jsName := JSStringCreateWithUTF8CString("name")
-	defer JSStringRelease(jsName)
+// post queues fn to be run on the UI thread during the next update tick
+func (w *Window) post(fn func()) {
+	w.mu.Lock()
+	w.tasks = append(w.tasks, fn)
+	w.mu.Unlock()
+
+	w.signal()
+}
+
+// signal wakes a frame loop waiting for work
+func (w *Window) signal() {
+	select {
+	case w.wake <- struct{}{}:
+	default:
+	}
+}
+
+// update is called by Ultralight once per tick on the UI thread
+func (w *Window) update(userData unsafe.Pointer) {
+	w.flush(time.Time{})
+}
+
+// flush runs queued tasks until deadline, if it is not zero, and then hands everything queued for the page over to JS
+func (w *Window) flush(deadline time.Time) {
+	w.mu.Lock()
+	tasks := w.tasks
+	w.tasks = nil
+	w.mu.Unlock()
+
+	for i, task := range tasks {
+		if !deadline.IsZero() && i > 0 && time.Now().After(deadline) {
+			w.mu.Lock()
+			w.tasks = append(tasks[i:len(tasks):len(tasks)], w.tasks...)
+			w.mu.Unlock()
+			break
+		}
+
+		task()
+	}
+
+	ctx := UlViewGetJSContext(w.view)
+
+	w.flushStreams(ctx)
+	w.flushSyncs(ctx)
+	w.patch.flush(ctx)
+	w.bus.flush(ctx)
+}
+
+// domReady re-installs bindings and injected scripts into the freshly loaded page
+func (w *Window) domReady() {
+	w.mu.Lock()
+	names := make([]string, 0, len(w.callbacks))
+	for name := range w.callbacks {
+		names = append(names, name)
+	}
+	w.mu.Unlock()
+
+	for _, name := range names {
+		w.addFunction(name)
+	}
+
+	w.mu.Lock()
+	scripts := append([]script(nil), w.scripts...)
+	for _, s := range w.syncs {
+		s.resend()
+	}
+	w.mu.Unlock()
+
+	for _, s := range scripts {
+		w.evaluate(s.js)
+	}
+}
+
+// inject evaluates js now and again every time a new page is loaded, replacing any earlier script registered under key
+func (w *Window) inject(key string, js string) {
+	w.mu.Lock()
+	w.uninjectLocked(key)
+	w.scripts = append(w.scripts, script{key, js})
+	w.mu.Unlock()
+
+	w.evaluate(js)
+}
+
+// uninject stops re-evaluating the script registered under key on new pages
+func (w *Window) uninject(key string) {
+	w.mu.Lock()
+	w.uninjectLocked(key)
+	w.mu.Unlock()
+}
 
-	prop := JSObjectGetProperty(ctx, functin, jsName, nil)
-	jsProp := JSValueToStringCopy(ctx, prop, nil)
-	defer JSStringRelease(jsProp)
+func (w *Window) uninjectLocked(key string) {
+	for i, s := range w.scripts {
+		if s.key == key {
+			w.scripts = append(w.scripts[:i], w.scripts[i+1:]...)
+			return
+		}
+	}
+}
 
-	name := fromJSString(jsProp)
+func (w *Window) evaluate(js string) JSValueRef {
+	us := UlCreateString(js)
+	defer UlDestroyString(us)
 
+	return UlViewEvaluateScript(w.view, us)
+}
+
+// script evaluates js in the view's context, reporting a thrown exception as an error
+func (w *Window) script(js string) (JSValueRef, error) {
+	ctx := UlViewGetJSContext(w.view)
+
+	str := JSStringCreateWithUTF8CString(js)
+	defer JSStringRelease(str)
+
+	exc := make([]JSValueRef, 1)
+	val := JSEvaluateScript(ctx, str, nil, nil, 1, exc)
+
+	if exc[0] != nil {
+		return nil, jsError(ctx, exc[0])
+	}
+
+	return val, nil
+}
+
+func (w *Window) ipcCallback(ctx JSContextRef, name string, args []JSValueRef, exception []JSValueRef) JSValueRef {
+	w.mu.Lock()
 	f, ok := w.callbacks[name]
+	w.mu.Unlock()
 
 	if !ok {
 		return JSValueMakeNull(ctx)
 	}
 
-	params := make([]reflect.Value, argumentCount)
+	if f.raw != nil {
+		return f.raw(ctx, args)
+	}
+
+	if f.stubbed() {
+		args = f.countStub(ctx, args)
+	}
+
+	if f.async {
+		return w.callAsync(ctx, f, args)
+	}
+
+	if f.batched {
+		return f.callBatch(w.pageContext(), ctx, args)
+	}
+
+	val, err := f.call(w.pageContext(), ctx, args)
+
+	if err != nil {
+		panic(err)
+	}
+
+	return val
+}
+
+// call decodes args into the function's parameter types and invokes it
+func (f *ipf) call(gctx context.Context, ctx JSContextRef, args []JSValueRef) (JSValueRef, error) {
+	params, err := f.decode(ctx, args)
 
-	for i := uint(0); i < argumentCount; i++ {
-		val, err := fromJSValue(ctx, arguments[i], f.ParamTypes[i])
+	if err != nil {
+		return nil, err
+	}
+
+	if f.memo != nil {
+		return returnValue(ctx, f.memo.call(f, gctx, params))
+	}
+
+	return returnValue(ctx, f.invoke(gctx, params))
+}
+
+// decode converts args into the function's parameter types, missing arguments are passed as zero values
+func (f *ipf) decode(ctx JSContextRef, args []JSValueRef) ([]reflect.Value, error) {
+	params := make([]reflect.Value, len(f.ParamTypes))
+
+	for i := range params {
+		if i >= len(args) {
+			params[i] = reflect.Zero(f.ParamTypes[i])
+			continue
+		}
+
+		val, err := fromJSValue(ctx, args[i], f.ParamTypes[i])
 
 		if err != nil {
-			panic(err)
+			return nil, err
 		}
 
 		params[i] = val
 	}
 
-	val := f.Function.Call(params)
+	return params, nil
+}
+
+// invoke calls the function with already decoded parameters, passing gctx first if the function takes a context
+func (f *ipf) invoke(gctx context.Context, params []reflect.Value) []reflect.Value {
+	atomic.AddUint64(&f.stats.Calls, 1)
+
+	if f.context {
+		params = append([]reflect.Value{reflect.ValueOf(&gctx).Elem()}, params...)
+	}
 
+	return f.Function.Call(params)
+}
+
+func returnValue(ctx JSContextRef, val []reflect.Value) (JSValueRef, error) {
 	if len(val) > 1 {
-		panic("Javascript does not support more than 1 return value!")
+		return nil, errors.New("Javascript does not support more than 1 return value!")
 	}
 
 	if len(val) == 0 {
-		return JSValueMakeNull(ctx)
+		return JSValueMakeNull(ctx), nil
 	}
 
-	return toJSValue(ctx, val[0])
+	return toJSValue(ctx, val[0]), nil
 }
 
 func fromJSValue(ctx JSContextRef, value JSValueRef, rtype reflect.Type) (reflect.Value, error) {
@@ -209,23 +589,14 @@ func fromJSValue(ctx JSContextRef, value JSValueRef, rtype reflect.Type) (reflec
 	var err error
 
 	if JSValueIsArray(ctx, value) {
-		l := JSStringCreateWithUTF8CString("length")
-		defer JSStringRelease(l)
-
-		obj := *(*JSObjectRef)(unsafe.Pointer(&value))
-
-		prop := JSObjectGetProperty(ctx, obj, l, nil)
-		length := int(JSValueToNumber(ctx, prop, nil))
-
 		if rtype.Kind() != reflect.Slice {
 			return reflect.Zero(rtype), errors.New("JS return is of type Array while Go type target is not")
 		}
 
-		values := reflect.MakeSlice(rtype, length, length)
-
-		for i := 0; i < length; i++ {
-			ref := JSObjectGetPropertyAtIndex(ctx, obj, uint32(i), nil)
+		refs := jsArrayElements(ctx, value)
+		values := reflect.MakeSlice(rtype, len(refs), len(refs))
 
+		for i, ref := range refs {
 			val, err := fromJSValue(ctx, ref, rtype.Elem())
 
 			if err != nil {
@@ -276,8 +647,12 @@ func toJSValue(ctx JSContextRef, value reflect.Value) JSValueRef {
 	var err error
 
 	switch value.Kind() {
-	case reflect.Float64:
+	case reflect.Float64, reflect.Float32:
 		jsv = JSValueMakeNumber(ctx, value.Float())
+	case reflect.Int, reflect.Int8, reflect.Int16, reflect.Int32, reflect.Int64:
+		jsv = JSValueMakeNumber(ctx, float64(value.Int()))
+	case reflect.Uint, reflect.Uint8, reflect.Uint16, reflect.Uint32, reflect.Uint64:
+		jsv = JSValueMakeNumber(ctx, float64(value.Uint()))
 	case reflect.Bool:
 		jsv = JSValueMakeBoolean(ctx, value.Bool())
 	case reflect.String:
@@ -286,20 +661,19 @@ func toJSValue(ctx JSContextRef, value reflect.Value) JSValueRef {
 		JSStringRelease(str)
 	case reflect.Ptr:
 		return toJSValue(ctx, reflect.Indirect(value))
-	case reflect.Struct:
-		if json, err := json.Marshal(value.Interface()); err == nil {
-			str := JSStringCreateWithUTF8CString(string(json))
-			jsv = JSValueMakeFromJSONString(ctx, str)
-			JSStringRelease(str)
-		}
+	case reflect.Interface:
+		return toJSValue(ctx, value.Elem())
+	case reflect.Invalid:
+		jsv = JSValueMakeNull(ctx)
+	case reflect.Struct, reflect.Map:
+		jsv = fromJSON(ctx, value)
 	case reflect.Slice, reflect.Array:
 		rets := make([]JSValueRef, value.Len())
 
 		for i := 0; i < value.Len(); i++ {
 			rets[i] = toJSValue(ctx, value.Index(i))
 		}
-		arr := JSObjectMakeArray(ctx, uint(len(rets)), rets, nil)
-		jsv = *(*JSValueRef)(unsafe.Pointer(&arr))
+		jsv = jsArray(ctx, rets)
 	default:
 		panic("Not implemented!")
 	}
@@ -313,20 +687,83 @@ func toJSValue(ctx JSContextRef, value reflect.Value) JSValueRef {
 
 func (w *Window) addFunction(name string) {
 	ctx := UlViewGetJSContext(w.view)
-	gobj := JSContextGetGlobalObject(ctx)
+	global := JSContextGetGlobalContext(ctx)
+
+	w.mu.Lock()
+	if w.global != global {
+		unregisterNatives(w.global)
+		registerNatives(global, w.ipcCallback)
+		w.global = global
+	}
+	w.mu.Unlock()
+
+	installFunction(ctx, name)
+}
+
+// jsArray creates a JS array holding vals
+func jsArray(ctx JSContextRef, vals []JSValueRef) JSValueRef {
+	arr := JSObjectMakeArray(ctx, uint(len(vals)), vals, nil)
+
+	return *(*JSValueRef)(unsafe.Pointer(&arr))
+}
 
-	fn := JSStringCreateWithUTF8CString(name)
-	defer JSStringRelease(fn)
+// jsArrayElements returns the elements of the JS array value
+func jsArrayElements(ctx JSContextRef, value JSValueRef) []JSValueRef {
+	l := JSStringCreateWithUTF8CString("length")
+	defer JSStringRelease(l)
 
-	fname := JSStringCreateWithUTF8CString("name")
-	defer JSStringRelease(fname)
+	obj := *(*JSObjectRef)(unsafe.Pointer(&value))
 
-	fob := JSObjectMakeFunctionWithCallback(ctx, fn, w.ipcCallback)
-	JSObjectSetProperty(ctx, fob, fname, JSValueMakeString(ctx, fname), KJSPropertyAttributeNone, []JSValueRef{})
+	prop := JSObjectGetProperty(ctx, obj, l, nil)
+	length := int(JSValueToNumber(ctx, prop, nil))
+
+	refs := make([]JSValueRef, length)
+
+	for i := range refs {
+		refs[i] = JSObjectGetPropertyAtIndex(ctx, obj, uint32(i), nil)
+	}
+
+	return refs
+}
+
+// jsLookup resolves a property path starting at the global object, returning nil if any part of it is not an object
+func jsLookup(ctx JSContextRef, path ...string) JSObjectRef {
+	obj := JSContextGetGlobalObject(ctx)
+
+	for _, name := range path {
+		str := JSStringCreateWithUTF8CString(name)
+		prop := JSObjectGetProperty(ctx, obj, str, nil)
+		JSStringRelease(str)
+
+		if !JSValueIsObject(ctx, prop) {
+			return nil
+		}
+
+		obj = *(*JSObjectRef)(unsafe.Pointer(&prop))
+	}
+
+	return obj
+}
+
+// jsError converts a thrown JS value into an error
+func jsError(ctx JSContextRef, exc JSValueRef) error {
+	str := JSValueToStringCopy(ctx, exc, nil)
+	defer JSStringRelease(str)
+
+	return errors.New(fromJSString(str))
+}
+
+// jsCall invokes the function found at path with the given arguments
+func jsCall(ctx JSContextRef, path []string, args ...JSValueRef) JSValueRef {
+	fn := jsLookup(ctx, path...)
+
+	if fn == nil || !JSObjectIsFunction(ctx, fn) {
+		return JSValueMakeUndefined(ctx)
+	}
 
-	val := *(*JSValueRef)(unsafe.Pointer(&fob))
+	this := jsLookup(ctx, path[:len(path)-1]...)
 
-	JSObjectSetProperty(ctx, gobj, fn, val, KJSPropertyAttributeNone, []JSValueRef{})
+	return JSObjectCallAsFunction(ctx, fn, this, uint(len(args)), args, nil)
 }
 
 func resizeCallback(ov ULOverlay) func(userData unsafe.Pointer, width uint32, height uint32) {
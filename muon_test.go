@@ -1,10 +1,22 @@
 package muon
 
 import (
+	"bytes"
+	"context"
+	"image"
+	"image/png"
+	"io/ioutil"
 	"net/http"
+	"net/http/httptest"
 	"os"
 	"reflect"
+	"strings"
+	"sync"
 	"testing"
+	"time"
+	"unsafe"
+
+	. "github.com/ImVexed/muon/ultralight"
 )
 
 var w *Window
@@ -136,3 +148,1260 @@ func TestMultipleFuncs(t *testing.T) {
 		t.Error(err)
 	}
 }
+
+func TestStream(t *testing.T) {
+	ch := make(chan float64)
+	done := make(chan []float64, 1)
+
+	w.Bind("streamTestDone", func(values []float64) {
+		done <- values
+	})
+
+	if err := w.Stream("streamTest", ch, &StreamConfig{HighWaterMark: 2}); err != nil {
+		t.Fatal(err)
+	}
+
+	_, err := w.Eval(`(async function () {
+		var values = [];
+		for await (const v of streamTest) values.push(v);
+		streamTestDone(values);
+	})()`, nil)
+
+	if err != nil {
+		t.Error(err)
+	}
+
+	for i := 1; i <= 5; i++ {
+		ch <- float64(i)
+	}
+	close(ch)
+
+	select {
+	case values := <-done:
+		if len(values) != 5 || values[0] != 1 || values[4] != 5 {
+			t.Errorf("values were not delivered in order, got %v", values)
+		}
+	case <-time.After(5 * time.Second):
+		t.Error("stream was not consumed")
+	}
+
+	// closing the Window must end a receiver blocked on a full buffer and one waiting on an idle channel
+	sw := &Window{awaits: make(map[float64]*awaiting), streams: make(map[string]*stream)}
+	sw.life, sw.quit = context.WithCancel(context.Background())
+
+	full, idle := make(chan int, 2), make(chan int)
+	full <- 1
+	full <- 2
+
+	returned := make(chan struct{}, 2)
+
+	for name, ch := range map[string]chan int{"full": full, "idle": idle} {
+		s := &stream{hwm: 1, policy: StreamBlock, wake: func() {}, done: sw.life.Done()}
+		s.cond = sync.NewCond(&s.mu)
+		sw.streams[name] = s
+
+		go func(ch chan int) {
+			s.receive(reflect.ValueOf(ch))
+			returned <- struct{}{}
+		}(ch)
+	}
+
+	time.Sleep(10 * time.Millisecond)
+	sw.shutdown()
+
+	for i := 0; i < 2; i++ {
+		select {
+		case <-returned:
+		case <-time.After(time.Second):
+			t.Fatal("stream receiver leaked after the Window was closed")
+		}
+	}
+}
+
+func TestEmit(t *testing.T) {
+	got := make(chan float64, 3)
+
+	w.Bind("emitTestListener", func(value float64) {
+		got <- value
+	})
+
+	_, err := w.Eval(`muon.on("emitTest", emitTestListener)`, nil)
+
+	if err != nil {
+		t.Error(err)
+	}
+
+	// emitting from a UI thread task puts all three payloads into the same tick
+	w.post(func() {
+		w.Emit("emitTest", 1)
+		w.Emit("emitTest", 2)
+		w.Emit("emitTest", 3)
+	})
+
+	select {
+	case value := <-got:
+		if value != 3 {
+			t.Errorf("intermediate payload %v was dispatched", value)
+		}
+	case <-time.After(5 * time.Second):
+		t.Fatal("latest payload was not dispatched")
+	}
+
+	select {
+	case value := <-got:
+		t.Errorf("payloads were not coalesced, %v was dispatched as well", value)
+	case <-time.After(200 * time.Millisecond):
+	}
+}
+
+func TestBatched(t *testing.T) {
+	done := make(chan []float64, 1)
+
+	w.Bind("batchTest", func(value float64) float64 {
+		return value * 2
+	}, Batched())
+
+	w.Bind("batchTestDone", func(values []float64) {
+		done <- values
+	})
+
+	_, err := w.Eval(`Promise.all([batchTest(1), batchTest(2), batchTest(3)]).then(batchTestDone)`, nil)
+
+	if err != nil {
+		t.Error(err)
+	}
+
+	select {
+	case values := <-done:
+		if len(values) != 3 || values[0] != 2 || values[1] != 4 || values[2] != 6 {
+			t.Errorf("batched results were not fanned out correctly, got %v", values)
+		}
+	case <-time.After(5 * time.Second):
+		t.Error("batched calls were not resolved")
+	}
+}
+
+func TestCoalesceLatest(t *testing.T) {
+	got := make(chan float64, 3)
+
+	w.Bind("coalesceTest", func(value float64) {
+		got <- value
+	}, CoalesceLatest())
+
+	_, err := w.Eval(`coalesceTest(1); coalesceTest(2); coalesceTest(3)`, nil)
+
+	if err != nil {
+		t.Error(err)
+	}
+
+	select {
+	case value := <-got:
+		if value != 3 {
+			t.Errorf("coalesced call did not carry the latest arguments, got %f", value)
+		}
+	case <-time.After(5 * time.Second):
+		t.Fatal("coalesced call was not made")
+	}
+
+	if stats := w.BindStats("coalesceTest"); stats.Calls != 1 || stats.Merged != 2 {
+		t.Errorf("stats did not count merged calls, got %+v", stats)
+	}
+}
+
+func TestMemoize(t *testing.T) {
+	done := make(chan []float64, 1)
+
+	w.Bind("memoTest", func(value float64) float64 {
+		time.Sleep(10 * time.Millisecond)
+		return value + 1
+	}, Async(), Memoize(16, time.Minute))
+
+	w.Bind("memoTestDone", func(values []float64) {
+		done <- values
+	})
+
+	_, err := w.Eval(`Promise.all([memoTest(1), memoTest(1), memoTest(2)]).then(memoTestDone)`, nil)
+
+	if err != nil {
+		t.Error(err)
+	}
+
+	select {
+	case values := <-done:
+		if len(values) != 3 || values[0] != 2 || values[1] != 2 || values[2] != 3 {
+			t.Errorf("memoized results were not correct, got %v", values)
+		}
+	case <-time.After(5 * time.Second):
+		t.Fatal("memoized calls were not resolved")
+	}
+
+	if stats := w.BindStats("memoTest"); stats.Calls != 2 || stats.Hits != 1 {
+		t.Errorf("identical calls were not collapsed, got %+v", stats)
+	}
+
+	w.Invalidate("memoTest", float64(1))
+
+	if _, err := w.Eval(`memoTest(1).then(function (v) { memoTestDone([v]); })`, nil); err != nil {
+		t.Error(err)
+	}
+
+	select {
+	case values := <-done:
+		if len(values) != 1 || values[0] != 2 {
+			t.Errorf("invalidated call returned %v", values)
+		}
+	case <-time.After(5 * time.Second):
+		t.Fatal("invalidated call was not resolved")
+	}
+
+	if stats := w.BindStats("memoTest"); stats.Calls != 3 || stats.Hits != 1 {
+		t.Errorf("invalidated result was served from the cache, got %+v", stats)
+	}
+}
+
+func TestMemoizePages(t *testing.T) {
+	f := &ipf{}
+	Memoize(16, 0)(f)
+
+	old, leave := context.WithCancel(context.Background())
+	params := []reflect.Value{reflect.ValueOf(1.0)}
+	release := make(chan struct{})
+	results := make(chan float64, 2)
+
+	settle := func(val []reflect.Value, err error) {
+		results <- val[0].Float()
+	}
+
+	f.memo.do(f, 1, old, params, func() ([]reflect.Value, error) {
+		<-release
+		return []reflect.Value{reflect.ValueOf(1.0)}, nil
+	}, settle)
+
+	// navigating cancels the first page's flight, the next page must run its own
+	leave()
+
+	f.memo.do(f, 2, context.Background(), params, func() ([]reflect.Value, error) {
+		return []reflect.Value{reflect.ValueOf(2.0)}, nil
+	}, settle)
+
+	if v := <-results; v != 2 {
+		t.Errorf("new page joined the cancelled flight, got %v", v)
+	}
+
+	close(release)
+
+	if v := <-results; v != 1 {
+		t.Errorf("cancelled flight did not settle its own caller, got %v", v)
+	}
+
+	if val, ok := f.memo.get(`[1]`); !ok || val[0].Float() != 2 {
+		t.Errorf("cancelled flight replaced the cached result, got %v %v", val, ok)
+	}
+}
+
+func TestAbort(t *testing.T) {
+	cancelled := make(chan struct{})
+
+	w.Bind("abortTest", func(ctx context.Context, query string) string {
+		<-ctx.Done()
+		close(cancelled)
+		return query
+	})
+
+	_, err := w.Eval(`(function () {
+		var controller = new AbortController();
+		abortTest("search", controller.signal).catch(function () {});
+		controller.abort();
+	})()`, nil)
+
+	if err != nil {
+		t.Error(err)
+	}
+
+	select {
+	case <-cancelled:
+	case <-time.After(5 * time.Second):
+		t.Error("context was not cancelled by the AbortSignal")
+	}
+}
+
+type syncState struct {
+	Title string
+	Items []string
+	Count int      `json:"count"`
+	Data  []byte   `json:"data"`
+	Tags  []string `json:"tags"`
+}
+
+func TestSync(t *testing.T) {
+	got := make(chan *syncState, 8)
+
+	w.Bind("syncTestListener", func(state *syncState) {
+		got <- state
+	})
+
+	state := &syncState{Title: "Hello", Items: []string{"a"}, Data: []byte{1, 2}}
+
+	s, err := w.Sync("syncTest", state)
+
+	if err != nil {
+		t.Fatal(err)
+	}
+
+	_, err = w.Eval(`
+		var syncOps = [];
+		var realSync = muon.sync;
+		muon.sync = function (name, ops) {
+			if (name === "syncTest") syncOps.push(JSON.stringify(ops));
+			return realSync.apply(this, arguments);
+		};
+		muon.on("sync:syncTest", syncTestListener)`, nil)
+
+	if err != nil {
+		t.Error(err)
+	}
+
+	select {
+	case <-got:
+	case <-time.After(5 * time.Second):
+		t.Fatal("initial state was not applied")
+	}
+
+	// The full state must look exactly like encoding/json would have produced it
+	res, err := w.Eval(`JSON.stringify(muon.state.syncTest)`, nil)
+
+	if err != nil {
+		t.Fatal(err)
+	}
+
+	if want := `{"Title":"Hello","Items":["a"],"count":0,"data":"AQI=","tags":null}`; res != want {
+		t.Errorf("expected %s, got %v", want, res)
+	}
+
+	state.Items = append(state.Items, "b")
+	state.Count = 2
+	s.Commit()
+
+	for {
+		select {
+		case res := <-got:
+			if res.Count == 2 {
+				if res.Title != "Hello" || len(res.Items) != 2 || res.Items[1] != "b" {
+					t.Errorf("state was not mirrored correctly, got %+v", res)
+				}
+
+				ops, err := w.Eval(`syncOps[syncOps.length - 1]`, nil)
+
+				if err != nil {
+					t.Fatal(err)
+				}
+
+				if want := `[[["Items",1],"b"],[["count"],2]]`; ops != want {
+					t.Errorf("expected only the diff %s to be sent, got %v", want, ops)
+				}
+				return
+			}
+		case <-time.After(5 * time.Second):
+			t.Fatal("state changes were not applied")
+		}
+	}
+}
+
+func TestPatch(t *testing.T) {
+	_, err := w.Eval(`var el = document.createElement("div"); el.id = "patchTest"; document.body.appendChild(el)`, nil)
+
+	if err != nil {
+		t.Fatal(err)
+	}
+
+	w.Patch().SetText("#patchTest", "stale")
+	w.Patch().SetText("#patchTest", "Hello, World!")
+	w.Patch().ToggleClass("#patchTest", "active", true)
+
+	deadline := time.Now().Add(5 * time.Second)
+
+	for time.Now().Before(deadline) {
+		res, err := w.Eval(`document.getElementById("patchTest").textContent + " " + document.getElementById("patchTest").className`, nil)
+
+		if err != nil {
+			t.Fatal(err)
+		}
+
+		if res.(string) == "Hello, World! active" {
+			return
+		}
+
+		time.Sleep(10 * time.Millisecond)
+	}
+
+	t.Error("patch was not applied")
+}
+
+func TestPatchOrder(t *testing.T) {
+	var p Patch
+
+	p.SetAttr("#a", "title", "stale")
+	p.SetAttr("#a", "title", "fresh")
+	p.SetText("#item", "stale")
+	p.SetHTML("#list", `<li id="item"></li>`)
+	p.SetText("#item", "fresh")
+
+	if got, want := patchOps(&p), []string{"#a=fresh", "#item=stale", `#list=<li id="item"></li>`, "#item=fresh"}; !reflect.DeepEqual(got, want) {
+		t.Errorf("expected %q, got %q", want, got)
+	}
+
+	// a repeated key moves behind operations on overlapping selectors queued in between
+	var o Patch
+
+	o.SetText(".cell", "X")
+	o.SetText("#a", "Y")
+	o.SetText(".cell", "Z")
+
+	if got, want := patchOps(&o), []string{"#a=Y", ".cell=Z"}; !reflect.DeepEqual(got, want) {
+		t.Errorf("expected %q, got %q", want, got)
+	}
+}
+
+// patchOps lists the operations p will apply as target=value
+func patchOps(p *Patch) []string {
+	var got []string
+
+	for _, op := range p.ops {
+		if !op.dropped {
+			got = append(got, op.target+"="+op.value)
+		}
+	}
+
+	return got
+}
+
+func TestRef(t *testing.T) {
+	ref, err := w.EvalRef(`({ count: 1, add: function (n) { this.count += n; return this.count; } })`)
+
+	if err != nil {
+		t.Fatal(err)
+	}
+
+	defer ref.Close()
+
+	if err := ref.Set("count", 10); err != nil {
+		t.Error(err)
+	}
+
+	res, err := ref.Call("add", nil, 5)
+
+	if err != nil {
+		t.Fatal(err)
+	}
+
+	if res.(float64) != 15 {
+		t.Errorf("add did not use the referenced object, got %f", res.(float64))
+	}
+
+	count, err := ref.Get("count", nil)
+
+	if err != nil {
+		t.Fatal(err)
+	}
+
+	if count.(float64) != 15 {
+		t.Errorf("count was not 15, got %f", count.(float64))
+	}
+
+	ref.Close()
+
+	if _, err := ref.Get("count", nil); err != ErrRefInvalid {
+		t.Errorf("closed Ref was still usable, got %v", err)
+	}
+
+	if _, err := w.EvalRef(`throw new Error("thrown")`); err == nil {
+		t.Error("exception was not reported")
+	}
+}
+
+func TestEvalAwait(t *testing.T) {
+	f := w.EvalAwait(`new Promise(function (resolve) { setTimeout(function () { resolve(42); }, 10); })`, nil)
+
+	select {
+	case <-f.Done():
+		res, err := f.Wait()
+
+		if err != nil {
+			t.Fatal(err)
+		}
+
+		if res.(float64) != 42 {
+			t.Errorf("awaited value was not 42, got %f", res.(float64))
+		}
+	case <-time.After(5 * time.Second):
+		t.Error("Promise was not awaited")
+	}
+
+	_, err := w.EvalAwait(`Promise.reject(new Error("failed"))`, nil).Wait()
+
+	if err == nil {
+		t.Error("rejection was not reported")
+	}
+
+	_, err = w.EvalAwait(`throw new Error("thrown")`, nil).Wait()
+
+	if err == nil {
+		t.Error("exception was not reported")
+	}
+}
+
+func TestAwaitClosed(t *testing.T) {
+	cw := &Window{awaits: make(map[float64]*awaiting)}
+	cw.life, cw.quit = context.WithCancel(context.Background())
+
+	pending := &Future{done: make(chan struct{})}
+	cw.awaits[1] = &awaiting{future: pending}
+
+	cw.shutdown()
+
+	if _, err := pending.Wait(); err != ErrWindowClosed {
+		t.Errorf("pending await was not failed on close, got %v", err)
+	}
+
+	if _, err := cw.EvalAwait(`1`, nil).Wait(); err != ErrWindowClosed {
+		t.Errorf("await after close did not fail, got %v", err)
+	}
+
+	// an await posted just before close has its task dropped, it must still fail instead of hanging
+	rw := &Window{awaits: make(map[float64]*awaiting), wake: make(chan struct{}, 1)}
+	rw.life, rw.quit = context.WithCancel(context.Background())
+
+	queued := rw.CallAwait("muon.test", nil)
+	rw.shutdown()
+
+	select {
+	case <-queued.Done():
+		if _, err := queued.Wait(); err != ErrWindowClosed {
+			t.Errorf("queued await was not failed on close, got %v", err)
+		}
+	case <-time.After(time.Second):
+		t.Fatal("queued await hung after close")
+	}
+
+	// its task must then return before touching the view when it runs
+	for _, task := range rw.tasks {
+		task()
+	}
+}
+
+func TestJSPool(t *testing.T) {
+	p := NewJSPool(2)
+	defer p.Close()
+
+	if err := p.Bind("double", func(value float64) float64 { return value * 2 }); err != nil {
+		t.Fatal(err)
+	}
+
+	if err := p.Load(`function quadruple(value) { return double(double(value)); }`); err != nil {
+		t.Fatal(err)
+	}
+
+	res, err := p.Call("quadruple", nil, 3)
+
+	if err != nil {
+		t.Fatal(err)
+	}
+
+	if res.(float64) != 12 {
+		t.Errorf("quadruple(3) was not 12, got %f", res.(float64))
+	}
+
+	if _, err := p.Eval(`throw new Error("failed")`, nil); err == nil {
+		t.Error("exception was not reported")
+	}
+}
+
+func TestEncodePNG(t *testing.T) {
+	src := image.NewRGBA(image.Rect(0, 0, 300, 200))
+
+	for i := 0; i < len(src.Pix); i += 4 {
+		a := byte(i / 4 % 256)
+		src.Pix[i], src.Pix[i+1], src.Pix[i+2], src.Pix[i+3] = a/2, a/3, a, a
+	}
+
+	var buf bytes.Buffer
+
+	if err := EncodePNG(&buf, src); err != nil {
+		t.Fatal(err)
+	}
+
+	img, err := png.Decode(&buf)
+
+	if err != nil {
+		t.Fatal(err)
+	}
+
+	if !bytes.Equal(img.(*image.NRGBA).Pix, Unpremultiply(nil, src).Pix) {
+		t.Error("decoded pixels did not match the unpremultiplied source")
+	}
+}
+
+// benchFrame is a 720p frame with gradients and flat areas, roughly what a rendered page compresses like
+func benchFrame() *image.RGBA {
+	img := image.NewRGBA(image.Rect(0, 0, 1280, 720))
+
+	for y := 0; y < 720; y++ {
+		for x := 0; x < 1280; x++ {
+			p := img.Pix[img.PixOffset(x, y):]
+
+			if y%120 < 60 {
+				p[0], p[1], p[2], p[3] = 255, 255, 255, 255
+			} else {
+				p[0], p[1], p[2], p[3] = byte(x), byte(y), byte(x^y), 255
+			}
+		}
+	}
+
+	return img
+}
+
+func BenchmarkEncodePNG(b *testing.B) {
+	img := benchFrame()
+	b.SetBytes(int64(len(img.Pix)))
+
+	for i := 0; i < b.N; i++ {
+		EncodePNG(ioutil.Discard, img)
+	}
+}
+
+func BenchmarkEncodePNGStdlib(b *testing.B) {
+	img := benchFrame()
+	b.SetBytes(int64(len(img.Pix)))
+
+	for i := 0; i < b.N; i++ {
+		png.Encode(ioutil.Discard, img)
+	}
+}
+
+func TestDiffer(t *testing.T) {
+	d := NewDiffer(&DeltaConfig{TileSize: 16, KeyframeInterval: 10})
+	img := image.NewRGBA(image.Rect(0, 0, 100, 50))
+
+	if delta := d.Diff(img); delta == nil || !delta.Keyframe {
+		t.Fatal("first frame was not a keyframe")
+	}
+
+	if delta := d.Diff(img); delta != nil {
+		t.Error("unchanged frame produced a delta")
+	}
+
+	img.Pix[img.PixOffset(40, 20)] = 255
+
+	delta := d.Diff(img)
+
+	if delta == nil || delta.Keyframe || len(delta.Rects) != 1 {
+		t.Fatal("changed pixel did not produce a single dirty rect")
+	}
+
+	if delta.Rects[0].Rectangle != image.Rect(32, 16, 48, 32) {
+		t.Errorf("dirty rect was not the changed tile, got %v", delta.Rects[0].Rectangle)
+	}
+}
+
+func TestCached(t *testing.T) {
+	calls := 0
+
+	h := Cached(http.HandlerFunc(func(w http.ResponseWriter, r *http.Request) {
+		calls++
+		w.Header().Set("Content-Type", "application/javascript")
+		w.Write(bytes.Repeat([]byte("console.log(1);"), 100))
+	}), nil)
+
+	rec := httptest.NewRecorder()
+	h.ServeHTTP(rec, httptest.NewRequest("GET", "/app.3f9a2c1d.js", nil))
+
+	etag := rec.Header().Get("ETag")
+
+	if etag == "" || rec.Header().Get("Cache-Control") != "public, max-age=31536000, immutable" {
+		t.Fatalf("fingerprinted response was not marked immutable, got %v", rec.Header())
+	}
+
+	req := httptest.NewRequest("GET", "/app.3f9a2c1d.js", nil)
+	req.Header.Set("If-None-Match", etag)
+	req.Header.Set("Accept-Encoding", "gzip")
+
+	rec = httptest.NewRecorder()
+	h.ServeHTTP(rec, req)
+
+	if rec.Code != http.StatusNotModified {
+		t.Errorf("conditional request was not answered with 304, got %d", rec.Code)
+	}
+
+	if calls != 1 {
+		t.Errorf("handler was called %d times instead of once", calls)
+	}
+}
+
+func TestCachedPassThrough(t *testing.T) {
+	calls := 0
+
+	h := Cached(http.HandlerFunc(func(w http.ResponseWriter, r *http.Request) {
+		calls++
+
+		switch r.URL.Path {
+		case "/private":
+			w.Header().Set("Cache-Control", "no-store")
+		case "/stale":
+			w.Header().Set("Cache-Control", "max-age=0")
+		case "/expired":
+			w.Header().Set("Expires", "Thu, 01 Jan 1970 00:00:00 GMT")
+		}
+
+		w.Write([]byte("body"))
+	}), nil)
+
+	for _, name := range []string{"/private", "/stale", "/expired", "/report-20240115.pdf"} {
+		calls = 0
+
+		for i := 0; i < 2; i++ {
+			rec := httptest.NewRecorder()
+			h.ServeHTTP(rec, httptest.NewRequest("GET", name, nil))
+
+			if rec.Body.String() != "body" {
+				t.Errorf("%s was not passed through, got %q", name, rec.Body.String())
+			}
+
+			if strings.Contains(rec.Header().Get("Cache-Control"), "immutable") {
+				t.Errorf("%s was marked immutable", name)
+			}
+		}
+
+		if name == "/report-20240115.pdf" {
+			if calls != 1 {
+				t.Errorf("%s was not cached, handler was called %d times", name, calls)
+			}
+		} else if calls != 2 {
+			t.Errorf("%s was cached, handler was called %d times", name, calls)
+		}
+	}
+}
+
+func TestCachedEviction(t *testing.T) {
+	calls := map[string]int{}
+
+	h := Cached(http.HandlerFunc(func(w http.ResponseWriter, r *http.Request) {
+		calls[r.URL.Path]++
+
+		if r.URL.Path == "/short" {
+			w.Header().Set("Cache-Control", "max-age=1")
+		}
+
+		w.Write(bytes.Repeat([]byte("x"), 600))
+	}), &CacheConfig{MaxBytes: 1000})
+
+	get := func(name string) {
+		h.ServeHTTP(httptest.NewRecorder(), httptest.NewRequest("GET", name, nil))
+	}
+
+	get("/a")
+	get("/a")
+	get("/b")
+	get("/a")
+
+	if calls["/a"] != 2 || calls["/b"] != 1 {
+		t.Errorf("the least recently used response was not evicted, got %v", calls)
+	}
+
+	get("/short")
+	get("/short")
+
+	if calls["/short"] != 1 {
+		t.Errorf("a fresh response was not cached, got %v", calls)
+	}
+
+	time.Sleep(1100 * time.Millisecond)
+	get("/short")
+
+	if calls["/short"] != 2 {
+		t.Errorf("a response past its max-age was served from the cache, got %v", calls)
+	}
+}
+
+func TestCachedVary(t *testing.T) {
+	calls := 0
+
+	h := Cached(http.HandlerFunc(func(w http.ResponseWriter, r *http.Request) {
+		calls++
+		w.Header().Set("Vary", "Accept-Language")
+		w.Write([]byte(r.Header.Get("Accept-Language")))
+	}), nil)
+
+	for _, lang := range []string{"en", "de"} {
+		req := httptest.NewRequest("GET", "/greeting", nil)
+		req.Header.Set("Accept-Language", lang)
+
+		rec := httptest.NewRecorder()
+		h.ServeHTTP(rec, req)
+
+		if rec.Body.String() != lang {
+			t.Errorf("expected the %s response, got %q", lang, rec.Body.String())
+		}
+	}
+
+	if calls != 2 {
+		t.Errorf("a response with Vary was cached, handler was called %d times", calls)
+	}
+}
+
+func TestNavigateInflight(t *testing.T) {
+	oldDone := make(chan struct{})
+	newDone := make(chan struct{})
+	cancelled := make(chan struct{}, 1)
+	results := make(chan string, 2)
+
+	w.Bind("navigateTestResult", func(res string) {
+		results <- res
+	})
+
+	w.Bind("navigateTest", func(ctx context.Context, tag string) string {
+		if tag == "old" {
+			// outlives its page without looking at ctx
+			<-oldDone
+			return tag
+		}
+
+		select {
+		case <-ctx.Done():
+			cancelled <- struct{}{}
+		case <-newDone:
+		}
+
+		return tag
+	})
+
+	reload := func() {
+		if _, err := w.Eval(`window.navigateTestMarker = true; location.reload()`, nil); err != nil {
+			t.Fatal(err)
+		}
+
+		deadline := time.After(5 * time.Second)
+
+		for {
+			res, err := w.Eval(`typeof navigateTestMarker === "undefined" && typeof navigateTest === "function"`, reflect.TypeOf(true))
+
+			if err == nil && res.(bool) {
+				return
+			}
+
+			select {
+			case <-deadline:
+				t.Fatal("page was not reloaded")
+			case <-time.After(50 * time.Millisecond):
+			}
+		}
+	}
+
+	// both pages start counting call ids from scratch, so the two calls share an id
+	reload()
+
+	if _, err := w.Eval(`navigateTest("old").then(navigateTestResult)`, nil); err != nil {
+		t.Fatal(err)
+	}
+
+	reload()
+
+	if _, err := w.Eval(`navigateTest("new").then(navigateTestResult)`, nil); err != nil {
+		t.Fatal(err)
+	}
+
+	close(oldDone)
+
+	select {
+	case <-cancelled:
+		t.Fatal("the new page's call was cancelled by the old page's call finishing")
+	case res := <-results:
+		t.Fatalf("a call settled before the new page's call finished, got %s", res)
+	case <-time.After(500 * time.Millisecond):
+	}
+
+	close(newDone)
+
+	select {
+	case res := <-results:
+		if res != "new" {
+			t.Errorf("the new page's call settled with %s", res)
+		}
+	case <-time.After(5 * time.Second):
+		t.Error("the new page's call did not settle")
+	}
+}
+
+func TestVirtualClock(t *testing.T) {
+	p := NewJSPool(1)
+	defer p.Close()
+
+	if err := p.Load(`var muon = {};`); err != nil {
+		t.Fatal(err)
+	}
+
+	if err := p.Load(clockJS); err != nil {
+		t.Fatal(err)
+	}
+
+	res, err := p.Eval(`(function () {
+		var log = [], spins = 0;
+
+		setTimeout(function () { log.push("t50@" + (Date.now() % 1000)); }, 50);
+		var iv = setInterval(function () { log.push("i30@" + (Date.now() % 1000)); }, 30);
+		requestAnimationFrame(function (t) { log.push("raf@" + t); });
+
+		muon.clock.advance(100);
+		clearInterval(iv);
+
+		// a callback rescheduling itself without delay must not keep advance from returning
+		var spin = function () { spins++; setTimeout(spin, 0); };
+		setTimeout(spin, 0);
+		muon.clock.advance(16);
+
+		return log.join(" ") + " spins=" + spins;
+	})()`, reflect.TypeOf(""))
+
+	if err != nil {
+		t.Fatal(err)
+	}
+
+	if want := "i30@30 t50@50 i30@60 i30@90 raf@100 spins=16"; res.(string) != want {
+		t.Errorf("virtual timers ran as %q, want %q", res.(string), want)
+	}
+}
+
+func TestPowerPolicy(t *testing.T) {
+	tests := []struct {
+		policy   PowerPolicy
+		hidden   bool
+		interval time.Duration
+		render   bool
+	}{
+		{PowerPolicy{}, false, 0, true},
+		{PowerPolicy{}, true, 500 * time.Millisecond, false},
+		{PowerPolicy{HiddenInterval: time.Minute}, false, 0, true},
+		{PowerPolicy{HiddenInterval: time.Minute}, true, time.Minute, false},
+		{PowerPolicy{Disabled: true}, true, 0, true},
+	}
+
+	for _, test := range tests {
+		interval, render := test.policy.interval(test.hidden)
+
+		if interval != test.interval || render != test.render {
+			t.Errorf("%+v hidden=%v: expected %v %v, got %v %v",
+				test.policy, test.hidden, test.interval, test.render, interval, render)
+		}
+	}
+}
+
+func TestPumpWindowed(t *testing.T) {
+	defer func() {
+		if recover() == nil {
+			t.Error("Pump did not panic on a windowed Window")
+		}
+	}()
+
+	w.Pump(time.Time{})
+}
+
+func TestSingleRenderer(t *testing.T) {
+	panics := func(name string, fn func()) {
+		defer func() {
+			if recover() == nil {
+				t.Errorf("%s did not panic while a Window holds the renderer", name)
+			}
+		}()
+
+		fn()
+	}
+
+	panics("New", func() { New(&Config{Headless: true}, nil) })
+	panics("NewRenderFarm", func() { NewRenderFarm(1, nil) })
+}
+
+func TestAdaptiveResolution(t *testing.T) {
+	a := &AdaptiveResolution{Budget: 10 * time.Millisecond, MinScale: 0.5, Step: 0.25}
+	var s scaler
+
+	changes := 0
+
+	for i := 0; i < 100; i++ {
+		if s.adapt(a, 40*time.Millisecond) {
+			changes++
+		}
+	}
+
+	if s.scale != 0.5 || changes != 2 {
+		t.Errorf("slow frames did not lower the scale to MinScale in two steps, got %v after %d changes", s.scale, changes)
+	}
+
+	for i := 0; i < 59; i++ {
+		if s.adapt(a, time.Millisecond) {
+			t.Fatalf("scale was raised after only %d fast frames", i+1)
+		}
+	}
+
+	for i := 0; i < 200; i++ {
+		s.adapt(a, time.Millisecond)
+	}
+
+	if s.scale != 1 {
+		t.Errorf("fast frames did not restore the full scale, got %v", s.scale)
+	}
+}
+
+func TestFarmPoll(t *testing.T) {
+	start := time.Now()
+
+	tests := []struct {
+		job      RenderJob
+		loaded   bool
+		domReady bool
+		after    time.Duration
+		want     int
+	}{
+		{RenderJob{}, false, false, time.Second, pollWaiting},
+		{RenderJob{}, false, true, time.Second, pollWaiting},
+		{RenderJob{WaitFor: WaitDOMReady}, false, true, time.Second, pollReady},
+		{RenderJob{}, true, true, time.Second, pollReady},
+		{RenderJob{Settle: time.Minute}, true, true, time.Second, pollWaiting},
+		{RenderJob{Timeout: time.Second}, false, false, 2 * time.Second, pollTimeout},
+		{RenderJob{}, false, false, time.Minute, pollTimeout},
+	}
+
+	for i, test := range tests {
+		job := test.job
+		v := &farmView{job: &job, started: start, loaded: test.loaded, domReady: test.domReady}
+
+		if got := v.poll(start.Add(test.after)); got != test.want {
+			t.Errorf("case %d: expected %d, got %d", i, test.want, got)
+		}
+	}
+}
+
+func TestFarmEncode(t *testing.T) {
+	f := &RenderFarm{
+		captured: make(chan capture, 3),
+		results:  make(chan *RenderResult),
+	}
+
+	f.queued = sync.NewCond(&f.mu)
+	go f.deliver()
+
+	img := image.NewRGBA(image.Rect(0, 0, 3, 2))
+
+	f.captured <- capture{job: &RenderJob{}, img: img}
+	f.captured <- capture{job: &RenderJob{Raw: true}, img: img}
+	f.captured <- capture{job: &RenderJob{}, err: ErrRenderTimeout}
+	close(f.captured)
+
+	// encoding must finish without anyone receiving, or a farm fed a whole batch up front deadlocks
+	f.encoders.Add(1)
+	f.encode()
+
+	f.mu.Lock()
+	f.encoded = true
+	f.queued.Broadcast()
+	f.mu.Unlock()
+
+	for i := 0; i < 3; i++ {
+		res := <-f.results
+
+		switch {
+		case res.Err != nil:
+			if res.Err != ErrRenderTimeout || res.Image != nil {
+				t.Errorf("failed capture was not reported, got %v", res.Err)
+			}
+		case res.Width != 3 || res.Height != 2:
+			t.Errorf("result size was not 3x2, got %dx%d", res.Width, res.Height)
+		case res.Job.Raw:
+			if len(res.Image) != 3*2*4 {
+				t.Errorf("raw image was not 24 bytes, got %d", len(res.Image))
+			}
+		default:
+			if dec, err := png.Decode(bytes.NewReader(res.Image)); err != nil || dec.Bounds() != img.Rect {
+				t.Errorf("PNG did not decode to a 3x2 image: %v", err)
+			}
+		}
+	}
+
+	if _, ok := <-f.results; ok {
+		t.Error("results were not closed after the encoders finished")
+	}
+}
+
+func TestViewEvents(t *testing.T) {
+	var a, b int
+	viewA, viewB := ULView(unsafe.Pointer(&a)), ULView(unsafe.Pointer(&b))
+
+	var got []string
+
+	views.Lock()
+	views.m[viewA] = &viewEvents{domReady: func() { got = append(got, "a") }}
+	views.m[viewB] = &viewEvents{finishLoading: func() { got = append(got, "b") }}
+	views.Unlock()
+
+	viewDOMReady(nil, viewA)
+	viewFinishLoading(nil, viewA)
+	viewFinishLoading(nil, viewB)
+
+	unregisterView(viewA)
+	unregisterView(viewB)
+
+	viewDOMReady(nil, viewA)
+
+	if want := []string{"a", "b"}; !reflect.DeepEqual(got, want) {
+		t.Errorf("events were not routed to their view, expected %v, got %v", want, got)
+	}
+}
+
+// wrappedFS hides the http.Dir it wraps, like any other http.FileSystem
+type wrappedFS struct {
+	http.FileSystem
+}
+
+func TestMounted(t *testing.T) {
+	tests := []struct {
+		cfg     Config
+		mounted bool
+	}{
+		{Config{}, false},
+		{Config{FileSystem: http.Dir(".")}, true},
+		{Config{FileSystem: http.Dir("."), Headless: true}, false},
+		{Config{FileSystem: wrappedFS{http.Dir(".")}}, false},
+	}
+
+	for _, test := range tests {
+		w := &Window{cfg: &test.cfg}
+
+		if w.mounted() != test.mounted {
+			t.Errorf("%T headless=%v: expected mounted=%v", test.cfg.FileSystem, test.cfg.Headless, test.mounted)
+		}
+	}
+}
+
+func TestRecordY4M(t *testing.T) {
+	f, err := ioutil.TempFile("", "record")
+
+	if err != nil {
+		t.Fatal(err)
+	}
+
+	f.Close()
+	defer os.Remove(f.Name())
+
+	y, err := newY4MWriter(f.Name(), 10)
+
+	if err != nil {
+		t.Fatal(err)
+	}
+
+	img := image.NewRGBA(image.Rect(0, 0, 4, 4))
+
+	// frames at 0ms and 350ms fill indices 0 to 3, stopping at 1s pads the video to 10 frames
+	for _, at := range []time.Duration{0, 350 * time.Millisecond} {
+		if err := y.frame(img, at); err != nil {
+			t.Fatal(err)
+		}
+	}
+
+	if err := y.close(time.Second); err != nil {
+		t.Fatal(err)
+	}
+
+	b, err := ioutil.ReadFile(f.Name())
+
+	if err != nil {
+		t.Fatal(err)
+	}
+
+	if !bytes.HasPrefix(b, []byte("YUV4MPEG2 W4 H4 F10:1")) {
+		t.Errorf("unexpected header %q", b[:bytes.IndexByte(b, '\n')])
+	}
+
+	if n := bytes.Count(b, []byte("FRAME\n")); n != 10 {
+		t.Errorf("expected 10 frames up to the stop time, got %d", n)
+	}
+}
+
+func TestBlit(t *testing.T) {
+	src := image.NewRGBA(image.Rect(0, 0, 100, 4))
+	stride := 100*4 + 16
+	dst := make([]byte, 4*stride)
+
+	if blit(dst[:len(dst)-20], stride, src, nil) {
+		t.Error("blit into a short buffer did not report false")
+	}
+
+	// pixels 70 and 3 of rows 1 and 2 change, which are compared in 64 pixel blocks
+	src.Pix[src.PixOffset(70, 1)] = 255
+	src.Pix[src.PixOffset(3, 2)] = 255
+
+	var bands []image.Rectangle
+
+	if !blit(dst, stride, src, func(r image.Rectangle) { bands = append(bands, r) }) {
+		t.Fatal("blit failed")
+	}
+
+	if want := []image.Rectangle{image.Rect(0, 1, 100, 3)}; !reflect.DeepEqual(bands, want) {
+		t.Errorf("expected dirty bands %v, got %v", want, bands)
+	}
+
+	if dst[stride+70*4] != 255 || dst[2*stride+3*4] != 255 {
+		t.Error("changed pixels were not copied")
+	}
+
+	bands = nil
+	blit(dst, stride, src, func(r image.Rectangle) { bands = append(bands, r) })
+
+	if len(bands) != 0 {
+		t.Errorf("unchanged frame reported dirty bands %v", bands)
+	}
+}
+
+func TestProfilePrecedence(t *testing.T) {
+	cfg := &Config{Profile: LowMemory, MemoryCacheSize: 32 * mb, UserStylesheet: "body { color: red; }"}
+	res := cfg.resolve()
+
+	if res.memoryCache != 32*mb || res.animationDelay != time.Second/30 {
+		t.Errorf("explicit fields did not override the profile, got %+v", res)
+	}
+
+	if res.power != profiles[LowMemory].power || cfg.Power != (PowerPolicy{}) {
+		t.Errorf("profile power policy was not applied without changing cfg, got %+v and %+v", res.power, cfg.Power)
+	}
+
+	if !strings.HasPrefix(res.stylesheet, reducedMotionCSS) || !strings.HasSuffix(res.stylesheet, cfg.UserStylesheet) {
+		t.Errorf("user stylesheet was not appended to the profile's, got %q", res.stylesheet)
+	}
+
+	cfg = &Config{Profile: Throughput, Power: PowerPolicy{HiddenInterval: time.Second}}
+
+	if res := cfg.resolve(); res.power != cfg.Power {
+		t.Errorf("explicit power policy did not override the profile, got %+v", res.power)
+	}
+
+	if res := (&Config{}).resolve(); res != (tuning{}) {
+		t.Errorf("default profile changed engine settings, got %+v", res)
+	}
+}
+
+func TestStreamDropped(t *testing.T) {
+	ch := make(chan int, 5)
+
+	for i := 1; i <= 5; i++ {
+		ch <- i
+	}
+
+	close(ch)
+
+	s := &stream{hwm: 2, policy: StreamDropNewest, wake: func() {}}
+	s.cond = sync.NewCond(&s.mu)
+	s.receive(reflect.ValueOf(ch))
+
+	sw := &Window{streams: map[string]*stream{"dropTest": s}}
+
+	if n := sw.StreamDropped("dropTest"); n != 3 || len(s.buf) != 2 || s.buf[1].Int() != 2 {
+		t.Errorf("expected 3 newest values dropped, got %d dropped and %v buffered", n, s.buf)
+	}
+}
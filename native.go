@@ -0,0 +1,71 @@
+package muon
+
+import (
+	"sync"
+	"unsafe"
+
+	. "github.com/ImVexed/muon/ultralight"
+)
+
+// nativeHandler answers a call from JS to the native function called name
+type nativeHandler func(ctx JSContextRef, name string, args []JSValueRef, exception []JSValueRef) JSValueRef
+
+// natives routes native function calls to their owner by global context, since the generated bindings
+// only ever hold on to the first callback passed to JSObjectMakeFunctionWithCallback
+var natives = struct {
+	sync.RWMutex
+	m map[JSGlobalContextRef]nativeHandler
+}{m: make(map[JSGlobalContextRef]nativeHandler)}
+
+func registerNatives(global JSGlobalContextRef, handler nativeHandler) {
+	natives.Lock()
+	natives.m[global] = handler
+	natives.Unlock()
+}
+
+func unregisterNatives(global JSGlobalContextRef) {
+	natives.Lock()
+	delete(natives.m, global)
+	natives.Unlock()
+}
+
+func nativeCallback(ctx JSContextRef, function JSObjectRef, thisObject JSObjectRef, argumentCount uint, arguments []JSValueRef, exception []JSValueRef) JSValueRef {
+	natives.RLock()
+	handler, ok := natives.m[JSContextGetGlobalContext(ctx)]
+	natives.RUnlock()
+
+	if !ok {
+		return JSValueMakeNull(ctx)
+	}
+
+	jsName := JSStringCreateWithUTF8CString("name")
+	defer JSStringRelease(jsName)
+
+	prop := JSObjectGetProperty(ctx, function, jsName, nil)
+	jsProp := JSValueToStringCopy(ctx, prop, nil)
+	defer JSStringRelease(jsProp)
+
+	return handler(ctx, fromJSString(jsProp), arguments[:argumentCount], exception)
+}
+
+// throw reports val as the exception of a native function call, the generated bindings hand the
+// exception out-parameter over with a capacity but no length
+func throw(exception []JSValueRef, val JSValueRef) {
+	if cap(exception) > 0 {
+		exception[:1][0] = val
+	}
+}
+
+// installFunction defines a native function called name on the global object of ctx
+func installFunction(ctx JSContextRef, name string) {
+	gobj := JSContextGetGlobalObject(ctx)
+
+	fn := JSStringCreateWithUTF8CString(name)
+	defer JSStringRelease(fn)
+
+	fob := JSObjectMakeFunctionWithCallback(ctx, fn, nativeCallback)
+
+	val := *(*JSValueRef)(unsafe.Pointer(&fob))
+
+	JSObjectSetProperty(ctx, gobj, fn, val, KJSPropertyAttributeNone, []JSValueRef{})
+}
@@ -0,0 +1,291 @@
+package muon
+
+import (
+	"encoding"
+	"encoding/json"
+	"reflect"
+	"sort"
+	"strings"
+	"sync"
+	"unicode"
+	"unsafe"
+
+	. "github.com/ImVexed/muon/ultralight"
+)
+
+var (
+	jsonMarshalerType = reflect.TypeOf((*json.Marshaler)(nil)).Elem()
+	textMarshalerType = reflect.TypeOf((*encoding.TextMarshaler)(nil)).Elem()
+
+	fieldCache sync.Map
+	plainCache sync.Map
+)
+
+// field is an exported struct field as encoding/json would name it
+type field struct {
+	name      string
+	index     []int
+	omitEmpty bool
+	quoted    bool
+	embedded  bool
+}
+
+// jsonFields returns the fields encoding/json would encode for the struct type t, flattening embedded structs
+func jsonFields(t reflect.Type) []field {
+	if fields, ok := fieldCache.Load(t); ok {
+		return fields.([]field)
+	}
+
+	var fields []field
+
+	for i := 0; i < t.NumField(); i++ {
+		sf := t.Field(i)
+		tag := sf.Tag.Get("json")
+
+		if tag == "-" {
+			continue
+		}
+
+		name, opts := tag, ""
+		if i := strings.Index(tag, ","); i >= 0 {
+			name, opts = tag[:i], tag[i:]
+		}
+
+		if sf.Anonymous && name == "" && sf.Type.Kind() == reflect.Struct {
+			for _, f := range jsonFields(sf.Type) {
+				f.index = append([]int{i}, f.index...)
+				fields = append(fields, f)
+			}
+			continue
+		}
+
+		if sf.Anonymous && name == "" && sf.Type.Kind() == reflect.Ptr {
+			fields = append(fields, field{name: sf.Name, index: []int{i}, embedded: true})
+			continue
+		}
+
+		if sf.PkgPath != "" {
+			continue
+		}
+
+		if name == "" {
+			name = sf.Name
+		}
+
+		fields = append(fields, field{
+			name:      name,
+			index:     []int{i},
+			omitEmpty: strings.Contains(opts, ",omitempty"),
+			quoted:    strings.Contains(opts, ",string"),
+		})
+	}
+
+	fieldCache.Store(t, fields)
+
+	return fields
+}
+
+// customJSON reports whether values of t control their own JSON encoding and so cannot be built field by field
+func customJSON(t reflect.Type) bool {
+	return t.Implements(jsonMarshalerType) || reflect.PtrTo(t).Implements(jsonMarshalerType) ||
+		t.Implements(textMarshalerType) || reflect.PtrTo(t).Implements(textMarshalerType)
+}
+
+// isEmpty mirrors encoding/json's notion of an empty value for omitempty
+func isEmpty(v reflect.Value) bool {
+	switch v.Kind() {
+	case reflect.Array, reflect.Map, reflect.Slice, reflect.String:
+		return v.Len() == 0
+	case reflect.Bool:
+		return !v.Bool()
+	case reflect.Int, reflect.Int8, reflect.Int16, reflect.Int32, reflect.Int64:
+		return v.Int() == 0
+	case reflect.Uint, reflect.Uint8, reflect.Uint16, reflect.Uint32, reflect.Uint64, reflect.Uintptr:
+		return v.Uint() == 0
+	case reflect.Float32, reflect.Float64:
+		return v.Float() == 0
+	case reflect.Interface, reflect.Ptr:
+		return v.IsNil()
+	}
+
+	return false
+}
+
+// plainJSON reports whether encoding/json encodes values of the struct, map, slice or array type t as a plain
+// object or array of its elements, which is what lets diff and toJSObject walk them instead of marshalling
+func plainJSON(t reflect.Type) bool {
+	if plain, ok := plainCache.Load(t); ok {
+		return plain.(bool)
+	}
+
+	plain := !customJSON(t) && !unsupported(t, map[reflect.Type]bool{})
+
+	switch t.Kind() {
+	case reflect.Struct:
+		names := make(map[string]bool)
+
+		for _, f := range jsonFields(t) {
+			if f.quoted || f.embedded || names[f.name] || !validTag(f.name) {
+				plain = false
+			}
+			names[f.name] = true
+		}
+	case reflect.Map:
+		plain = plain && t.Key().Kind() == reflect.String && !customJSON(t.Key())
+	case reflect.Slice:
+		plain = plain && t.Elem().Kind() != reflect.Uint8
+	case reflect.Array:
+	default:
+		plain = false
+	}
+
+	plainCache.Store(t, plain)
+
+	return plain
+}
+
+// unsupported reports whether encoding/json fails on t because it reaches a func, chan or complex value
+func unsupported(t reflect.Type, seen map[reflect.Type]bool) bool {
+	if seen[t] {
+		return false
+	}
+	seen[t] = true
+
+	if customJSON(t) {
+		return false
+	}
+
+	switch t.Kind() {
+	case reflect.Func, reflect.Chan, reflect.Complex64, reflect.Complex128, reflect.UnsafePointer:
+		return true
+	case reflect.Ptr, reflect.Slice, reflect.Array:
+		return unsupported(t.Elem(), seen)
+	case reflect.Map:
+		return unsupported(t.Key(), seen) || unsupported(t.Elem(), seen)
+	case reflect.Struct:
+		for _, f := range jsonFields(t) {
+			if unsupported(t.FieldByIndex(f.index).Type, seen) {
+				return true
+			}
+		}
+	}
+
+	return false
+}
+
+// validTag mirrors encoding/json, which ignores tag names with characters outside this set
+func validTag(name string) bool {
+	for _, c := range name {
+		switch {
+		case strings.ContainsRune("!#$%&()*+-./:;<=>?@[]^_{|}~ ", c):
+		case !unicode.IsLetter(c) && !unicode.IsDigit(c):
+			return false
+		}
+	}
+
+	return name != ""
+}
+
+// fromJSON converts value through encoding/json, yielding null when it cannot be marshalled
+func fromJSON(ctx JSContextRef, value reflect.Value) JSValueRef {
+	json, err := json.Marshal(value.Interface())
+
+	if err != nil {
+		return JSValueMakeNull(ctx)
+	}
+
+	str := JSStringCreateWithUTF8CString(string(json))
+	defer JSStringRelease(str)
+
+	return JSValueMakeFromJSONString(ctx, str)
+}
+
+// toSyncValue converts a Synced value, building plain structs, maps and arrays through the bridge and
+// everything encoding/json has its own rules for through encoding/json, so the page sees the same value either way
+func toSyncValue(ctx JSContextRef, value reflect.Value) JSValueRef {
+	if !value.IsValid() {
+		return JSValueMakeNull(ctx)
+	}
+
+	if customJSON(value.Type()) {
+		return fromJSON(ctx, value)
+	}
+
+	switch value.Kind() {
+	case reflect.Ptr, reflect.Interface:
+		if value.IsNil() {
+			return JSValueMakeNull(ctx)
+		}
+		return toSyncValue(ctx, value.Elem())
+	case reflect.Struct, reflect.Map:
+		if obj, ok := toJSObject(ctx, value); ok {
+			return obj
+		}
+	case reflect.Slice, reflect.Array:
+		if value.Kind() == reflect.Slice && value.IsNil() {
+			return JSValueMakeNull(ctx)
+		}
+
+		if !plainJSON(value.Type()) {
+			break
+		}
+
+		rets := make([]JSValueRef, value.Len())
+
+		for i := 0; i < value.Len(); i++ {
+			rets[i] = toSyncValue(ctx, value.Index(i))
+		}
+		return jsArray(ctx, rets)
+	case reflect.Bool, reflect.String, reflect.Int, reflect.Int8, reflect.Int16, reflect.Int32, reflect.Int64,
+		reflect.Uint, reflect.Uint8, reflect.Uint16, reflect.Uint32, reflect.Uint64:
+		return toJSValue(ctx, value)
+	}
+
+	return fromJSON(ctx, value)
+}
+
+// toJSObject builds a JS object from a struct or string keyed map directly through the bridge,
+// reporting false for values that have to go through encoding/json instead
+func toJSObject(ctx JSContextRef, value reflect.Value) (JSValueRef, bool) {
+	t := value.Type()
+
+	if !plainJSON(t) {
+		return nil, false
+	}
+
+	obj := JSObjectMake(ctx, nil, nil)
+
+	set := func(name string, v reflect.Value) {
+		str := JSStringCreateWithUTF8CString(name)
+		JSObjectSetProperty(ctx, obj, str, toSyncValue(ctx, v), KJSPropertyAttributeNone, nil)
+		JSStringRelease(str)
+	}
+
+	switch t.Kind() {
+	case reflect.Struct:
+		for _, f := range jsonFields(t) {
+			v := value.FieldByIndex(f.index)
+
+			if f.omitEmpty && isEmpty(v) {
+				continue
+			}
+
+			set(f.name, v)
+		}
+	case reflect.Map:
+		if value.IsNil() {
+			return JSValueMakeNull(ctx), true
+		}
+
+		keys := value.MapKeys()
+		sort.Slice(keys, func(i, j int) bool { return keys[i].String() < keys[j].String() })
+
+		for _, k := range keys {
+			set(k.String(), value.MapIndex(k))
+		}
+	default:
+		return nil, false
+	}
+
+	return *(*JSValueRef)(unsafe.Pointer(&obj)), true
+}
@@ -0,0 +1,174 @@
+package muon
+
+import (
+	"strconv"
+	"strings"
+	"sync"
+
+	. "github.com/ImVexed/muon/ultralight"
+)
+
+// patchSep separates the fields of encoded patch operations
+const patchSep = '\x1f'
+
+const (
+	patchText = iota
+	patchSetAttr
+	patchRemoveAttr
+	patchHTML
+	patchAddClass
+	patchRemoveClass
+)
+
+// Patch collects DOM operations from any goroutine and applies them to the page in one pass per update tick.
+// Targets are element ids prefixed with `#` or any CSS selector, in which case every matching element is updated.
+// A later operation on the same target and attribute replaces an earlier one that has not been applied yet and is
+// applied in the later one's place, after everything queued in between.
+type Patch struct {
+	mu   sync.Mutex
+	ops  []patchOp
+	keys map[string]int
+	wake func()
+}
+
+type patchOp struct {
+	code   int
+	target string
+	arg    string
+	value  string
+	// dropped marks an operation replaced by a later one with the same key
+	dropped bool
+}
+
+// Patch returns the Window's DOM patch queue
+func (w *Window) Patch() *Patch {
+	return &w.patch
+}
+
+// SetText replaces the text content of target
+func (p *Patch) SetText(target string, text string) {
+	p.add(patchOp{code: patchText, target: target, value: text})
+}
+
+// SetHTML replaces the inner HTML of target
+func (p *Patch) SetHTML(target string, html string) {
+	p.add(patchOp{code: patchHTML, target: target, value: html})
+}
+
+// SetAttr sets the attribute name of target to value
+func (p *Patch) SetAttr(target string, name string, value string) {
+	p.add(patchOp{code: patchSetAttr, target: target, arg: name, value: value})
+}
+
+// RemoveAttr removes the attribute name from target
+func (p *Patch) RemoveAttr(target string, name string) {
+	p.add(patchOp{code: patchRemoveAttr, target: target, arg: name})
+}
+
+// ToggleClass adds class to target when on is true and removes it otherwise
+func (p *Patch) ToggleClass(target string, class string, on bool) {
+	code := patchRemoveClass
+
+	if on {
+		code = patchAddClass
+	}
+
+	p.add(patchOp{code: code, target: target, arg: class})
+}
+
+func (p *Patch) add(op patchOp) {
+	// operations that overwrite the same state share a key so only the latest is applied. Markup replacements are
+	// never merged and nothing queued after one is merged into a slot before it, since later operations may target
+	// the elements it creates.
+	var key string
+
+	switch op.code {
+	case patchText, patchHTML:
+		key = "c\x00" + op.target
+	case patchSetAttr, patchRemoveAttr:
+		key = "a\x00" + op.target + "\x00" + op.arg
+	default:
+		key = "k\x00" + op.target + "\x00" + op.arg
+	}
+
+	p.mu.Lock()
+	defer p.mu.Unlock()
+
+	if p.wake != nil {
+		defer p.wake()
+	}
+
+	if op.code == patchHTML {
+		p.keys = nil
+		p.ops = append(p.ops, op)
+		return
+	}
+
+	if p.keys == nil {
+		p.keys = make(map[string]int)
+	}
+
+	// the earlier operation is dropped rather than overwritten in place, an operation queued in between on an
+	// overlapping selector must not end up applied after this one
+	if i, ok := p.keys[key]; ok {
+		p.ops[i].dropped = true
+	}
+
+	p.keys[key] = len(p.ops)
+	p.ops = append(p.ops, op)
+}
+
+// flush encodes the queued operations as a single separated string for the resident applier, must be called on the UI thread
+func (p *Patch) flush(ctx JSContextRef) {
+	p.mu.Lock()
+	ops := p.ops
+	p.ops = nil
+	p.keys = nil
+	p.mu.Unlock()
+
+	if len(ops) == 0 {
+		return
+	}
+
+	var b strings.Builder
+
+	for _, op := range ops {
+		if op.dropped {
+			continue
+		}
+
+		if b.Len() > 0 {
+			b.WriteByte(patchSep)
+		}
+
+		b.WriteString(strconv.Itoa(op.code))
+		b.WriteByte(patchSep)
+		b.WriteString(stripSep(op.target))
+		b.WriteByte(patchSep)
+		b.WriteString(stripSep(op.arg))
+		b.WriteByte(patchSep)
+		b.WriteString(stripSep(op.value))
+	}
+
+	str := JSStringCreateWithUTF8CString(b.String())
+	encoded := JSValueMakeString(ctx, str)
+	JSStringRelease(str)
+
+	jsCall(ctx, []string{"muon", "patch"}, encoded)
+}
+
+func (p *Patch) pending() bool {
+	p.mu.Lock()
+	defer p.mu.Unlock()
+
+	return len(p.ops) > 0
+}
+
+// stripSep removes the separator from s, it is a control character with no meaning in text or markup
+func stripSep(s string) string {
+	if strings.IndexByte(s, patchSep) < 0 {
+		return s
+	}
+
+	return strings.Replace(s, string(patchSep), "", -1)
+}
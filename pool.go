@@ -0,0 +1,287 @@
+package muon
+
+import (
+	"context"
+	"errors"
+	"reflect"
+	"runtime"
+	"strings"
+	"sync"
+
+	. "github.com/ImVexed/muon/ultralight"
+)
+
+// ErrPoolClosed is returned by a JSPool that has been closed
+var ErrPoolClosed = errors.New("JSPool is closed")
+
+// JSPool runs JavaScript without any view on a set of warm global contexts, each in its own context group on its
+// own locked OS thread, so independent scripts can be evaluated on all cores at once.
+type JSPool struct {
+	jobs    chan func(*engine)
+	engines []*engine
+	closed  chan struct{}
+	once    sync.Once
+
+	mu        sync.RWMutex
+	callbacks map[string]*ipf
+}
+
+type engine struct {
+	pool  *JSPool
+	group JSContextGroupRef
+	ctx   JSGlobalContextRef
+	ctl   chan func(*engine)
+}
+
+// NewJSPool starts a JSPool with n contexts, or one per CPU if n is 0
+func NewJSPool(n int) *JSPool {
+	if n <= 0 {
+		n = runtime.NumCPU()
+	}
+
+	p := &JSPool{
+		jobs:      make(chan func(*engine)),
+		closed:    make(chan struct{}),
+		callbacks: make(map[string]*ipf),
+	}
+
+	ready := make(chan struct{})
+
+	for i := 0; i < n; i++ {
+		e := &engine{
+			pool: p,
+			ctl:  make(chan func(*engine)),
+		}
+
+		p.engines = append(p.engines, e)
+
+		go e.run(ready)
+	}
+
+	for i := 0; i < n; i++ {
+		<-ready
+	}
+
+	return p
+}
+
+func (e *engine) run(ready chan<- struct{}) {
+	runtime.LockOSThread()
+	defer runtime.UnlockOSThread()
+
+	e.group = JSContextGroupCreate()
+	e.ctx = JSGlobalContextCreateInGroup(e.group, nil)
+
+	registerNatives(e.ctx, e.ipcCallback)
+
+	ready <- struct{}{}
+
+	for {
+		select {
+		case job := <-e.ctl:
+			job(e)
+		case job := <-e.pool.jobs:
+			job(e)
+		case <-e.pool.closed:
+			unregisterNatives(e.ctx)
+			JSGlobalContextRelease(e.ctx)
+			JSContextGroupRelease(e.group)
+			return
+		}
+	}
+}
+
+func (e *engine) context() JSContextRef {
+	return JSContextRef(e.ctx)
+}
+
+func (e *engine) ipcCallback(ctx JSContextRef, name string, args []JSValueRef, exception []JSValueRef) JSValueRef {
+	e.pool.mu.RLock()
+	f, ok := e.pool.callbacks[name]
+	e.pool.mu.RUnlock()
+
+	if !ok {
+		return JSValueMakeNull(ctx)
+	}
+
+	val, err := f.call(context.Background(), ctx, args)
+
+	if err != nil {
+		str := JSStringCreateWithUTF8CString(err.Error())
+		throw(exception, JSValueMakeString(ctx, str))
+		JSStringRelease(str)
+
+		return JSValueMakeUndefined(ctx)
+	}
+
+	return val
+}
+
+// broadcast runs job on every context and waits for all of them
+func (p *JSPool) broadcast(job func(*engine)) error {
+	var wg sync.WaitGroup
+
+	for _, e := range p.engines {
+		wg.Add(1)
+
+		select {
+		case e.ctl <- func(e *engine) {
+			defer wg.Done()
+			job(e)
+		}:
+		case <-p.closed:
+			wg.Done()
+			return ErrPoolClosed
+		}
+	}
+
+	wg.Wait()
+
+	return nil
+}
+
+// run runs job on the next free context and waits for it
+func (p *JSPool) run(job func(*engine)) error {
+	done := make(chan struct{})
+
+	select {
+	case p.jobs <- func(e *engine) {
+		defer close(done)
+		job(e)
+	}:
+	case <-p.closed:
+		return ErrPoolClosed
+	}
+
+	<-done
+
+	return nil
+}
+
+// Bind registers the given function to the given name in the global object of every context in the pool.
+// Calls run synchronously on the calling context; Memoize is honoured, options that need a page are not.
+func (p *JSPool) Bind(name string, function interface{}, opts ...BindOption) error {
+	f := newIPF(name, function, opts)
+	f.batched, f.async, f.limit = false, false, ""
+
+	p.mu.Lock()
+	p.callbacks[name] = f
+	p.mu.Unlock()
+
+	return p.broadcast(func(e *engine) {
+		installFunction(e.context(), name)
+	})
+}
+
+// Load evaluates js in every context of the pool, typically to define functions later used through Call
+func (p *JSPool) Load(js string) error {
+	var mu sync.Mutex
+	var first error
+
+	err := p.broadcast(func(e *engine) {
+		if _, err := e.evaluate(js); err != nil {
+			mu.Lock()
+			if first == nil {
+				first = err
+			}
+			mu.Unlock()
+		}
+	})
+
+	if err != nil {
+		return err
+	}
+
+	return first
+}
+
+// Eval evaluates a given JavaScript string on the next free context. `ret` is necessary for JSON serialization if an object is returned.
+func (p *JSPool) Eval(js string, ret reflect.Type) (interface{}, error) {
+	var res interface{}
+	var err error
+
+	if perr := p.run(func(e *engine) {
+		var val JSValueRef
+
+		if val, err = e.evaluate(js); err != nil {
+			return
+		}
+
+		res, err = e.convert(val, ret)
+	}); perr != nil {
+		return nil, perr
+	}
+
+	return res, err
+}
+
+// Call calls the JS function found at the dotted path fn with args on the next free context
+func (p *JSPool) Call(fn string, ret reflect.Type, args ...interface{}) (interface{}, error) {
+	var res interface{}
+	var err error
+
+	if perr := p.run(func(e *engine) {
+		ctx := e.context()
+		path := strings.Split(fn, ".")
+
+		obj := jsLookup(ctx, path...)
+
+		if obj == nil || !JSObjectIsFunction(ctx, obj) {
+			err = errors.New(fn + " is not a function")
+			return
+		}
+
+		vals := make([]JSValueRef, len(args))
+
+		for i, arg := range args {
+			vals[i] = toJSValue(ctx, reflect.ValueOf(arg))
+		}
+
+		exc := make([]JSValueRef, 1)
+		val := JSObjectCallAsFunction(ctx, obj, jsLookup(ctx, path[:len(path)-1]...), uint(len(vals)), vals, exc)
+
+		if exc[0] != nil {
+			err = jsError(ctx, exc[0])
+			return
+		}
+
+		res, err = e.convert(val, ret)
+	}); perr != nil {
+		return nil, perr
+	}
+
+	return res, err
+}
+
+// Close stops every context in the pool, calls in progress are finished first
+func (p *JSPool) Close() {
+	p.once.Do(func() {
+		close(p.closed)
+	})
+}
+
+func (e *engine) evaluate(js string) (JSValueRef, error) {
+	ctx := e.context()
+
+	str := JSStringCreateWithUTF8CString(js)
+	defer JSStringRelease(str)
+
+	exc := make([]JSValueRef, 1)
+	val := JSEvaluateScript(ctx, str, nil, nil, 1, exc)
+
+	if exc[0] != nil {
+		return nil, jsError(ctx, exc[0])
+	}
+
+	return val, nil
+}
+
+func (e *engine) convert(val JSValueRef, ret reflect.Type) (interface{}, error) {
+	rv, err := fromJSValue(e.context(), val, ret)
+
+	if err != nil {
+		return nil, err
+	}
+
+	return rv.Interface(), nil
+}
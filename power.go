@@ -0,0 +1,59 @@
+package muon
+
+import (
+	"sync/atomic"
+	"time"
+
+	. "github.com/ImVexed/muon/ultralight"
+)
+
+// PowerPolicy controls how often a headless Window's frame loop runs while the Window is hidden. Windowed Windows
+// are driven by AppCore's own loop, which the policy has no effect on.
+type PowerPolicy struct {
+	// Disabled keeps the frame loop running at full rate at all times
+	Disabled bool
+	// HiddenInterval is the minimum time between frames while the Window is hidden, defaults to 500ms.
+	// Hidden Windows are not rendered at all.
+	HiddenInterval time.Duration
+}
+
+// Hide hides the Window. A hidden headless Window stops rendering and runs its frame loop at the policy's
+// HiddenInterval.
+func (w *Window) Hide() {
+	if w.cfg.Headless {
+		atomic.StoreInt32(&w.hidden, 1)
+		return
+	}
+
+	UlOverlayHide(w.ov)
+}
+
+// Show shows the Window again after Hide
+func (w *Window) Show() {
+	if w.cfg.Headless {
+		atomic.StoreInt32(&w.hidden, 0)
+		w.signal()
+		return
+	}
+
+	UlOverlayShow(w.ov)
+}
+
+// interval returns how long the policy wants between frames of a headless Window, zero meaning full rate,
+// and whether frames should be rendered at all
+func (p PowerPolicy) interval(hidden bool) (time.Duration, bool) {
+	if p.Disabled || !hidden {
+		return 0, true
+	}
+
+	if p.HiddenInterval <= 0 {
+		return 500 * time.Millisecond, false
+	}
+
+	return p.HiddenInterval, false
+}
+
+// throttle applies the power policy to the headless Window's current state, see PowerPolicy.interval
+func (w *Window) throttle() (time.Duration, bool) {
+	return w.power.interval(atomic.LoadInt32(&w.hidden) == 1)
+}
@@ -0,0 +1,126 @@
+package muon
+
+import (
+	"time"
+
+	. "github.com/ImVexed/muon/ultralight"
+)
+
+// Profile is a named combination of engine and power settings
+type Profile int
+
+const (
+	// DefaultProfile leaves Ultralight's own defaults in place
+	DefaultProfile Profile = iota
+	// LowMemory shrinks the caches, slows animations, ticks rarely in the background and asks pages for reduced motion
+	LowMemory
+	// LowLatency animates at 120Hz and keeps enough cache for pages to never wait on a reload
+	LowLatency
+	// Throughput suits headless rendering: large caches, no back/forward cache and no background throttling
+	Throughput
+	// Kiosk runs a single full screen page that never leaves the foreground, without scrollbars or text selection
+	Kiosk
+)
+
+const mb = 1024 * 1024
+
+// reducedMotionCSS stands in for prefers-reduced-motion on pages that never check for it
+const reducedMotionCSS = `*, *::before, *::after {
+	animation-duration: 0.001s !important;
+	animation-iteration-count: 1 !important;
+	transition-duration: 0.001s !important;
+	scroll-behavior: auto !important;
+}`
+
+const kioskCSS = `::-webkit-scrollbar { display: none; }
+* { -webkit-user-select: none; user-select: none; }`
+
+type tuning struct {
+	memoryCache    uint32
+	pageCache      uint32
+	animationDelay time.Duration
+	stylesheet     string
+	power          PowerPolicy
+}
+
+var profiles = map[Profile]tuning{
+	LowMemory: {
+		memoryCache:    16 * mb,
+		animationDelay: time.Second / 30,
+		stylesheet:     reducedMotionCSS,
+		power:          PowerPolicy{HiddenInterval: 2 * time.Second},
+	},
+	LowLatency: {
+		memoryCache:    128 * mb,
+		pageCache:      4,
+		animationDelay: time.Second / 120,
+	},
+	Throughput: {
+		memoryCache: 256 * mb,
+		power:       PowerPolicy{Disabled: true},
+	},
+	Kiosk: {
+		memoryCache: 64 * mb,
+		stylesheet:  kioskCSS,
+	},
+}
+
+// resolve applies cfg's profile, explicitly set fields take precedence over it. cfg itself is left untouched.
+func (cfg *Config) resolve() tuning {
+	t := profiles[cfg.Profile]
+
+	if cfg.Power != (PowerPolicy{}) {
+		t.power = cfg.Power
+	}
+
+	if cfg.MemoryCacheSize > 0 {
+		t.memoryCache = cfg.MemoryCacheSize
+	}
+
+	if cfg.PageCacheSize > 0 {
+		t.pageCache = cfg.PageCacheSize
+	}
+
+	if cfg.AnimationTimerDelay > 0 {
+		t.animationDelay = cfg.AnimationTimerDelay
+	}
+
+	if cfg.UserStylesheet != "" {
+		t.stylesheet += "\n" + cfg.UserStylesheet
+	}
+
+	return t
+}
+
+// engine builds the ULConfig for cfg, see resolve
+func (cfg *Config) engine() ULConfig {
+	t := cfg.resolve()
+	ufg := UlCreateConfig()
+
+	if t.memoryCache > 0 {
+		UlConfigSetMemoryCacheSize(ufg, t.memoryCache)
+	}
+
+	if t.pageCache > 0 {
+		UlConfigSetPageCacheSize(ufg, t.pageCache)
+	}
+
+	if t.animationDelay > 0 {
+		UlConfigSetAnimationTimerDelay(ufg, t.animationDelay.Seconds())
+	}
+
+	if cfg.DeviceScale > 0 {
+		UlConfigSetDeviceScaleHint(ufg, cfg.DeviceScale)
+	}
+
+	UlConfigSetForceRepaint(ufg, cfg.ForceRepaint)
+	UlConfigSetEnableImages(ufg, !cfg.DisableImages)
+
+	if t.stylesheet != "" {
+		str := UlCreateString(t.stylesheet)
+		UlConfigSetUserStylesheet(ufg, str)
+		UlDestroyString(str)
+	}
+
+	return ufg
+}
@@ -0,0 +1,106 @@
+package muon
+
+import (
+	"time"
+
+	. "github.com/ImVexed/muon/ultralight"
+)
+
+// Tick processes a single frame of a headless Window and reports whether more work is pending, see Pump
+func (w *Window) Tick() bool {
+	return w.Pump(time.Time{})
+}
+
+// Pump processes a single frame of a headless Window: it runs work queued for the UI thread until deadline
+// (if not zero), flushes streams, events, state and patches to the page, and updates and renders the view.
+// It reports whether work is still pending, so callers can skip frames while it returns false and Wake does not fire.
+// Pump is only available on headless Windows and panics on windowed ones, whose frames are driven by Start.
+// It must always be called from the goroutine that called New, which New locked to its OS thread.
+func (w *Window) Pump(deadline time.Time) bool {
+	if !w.cfg.Headless {
+		panic("Pump requires a headless Window, windowed frames are driven by Start")
+	}
+
+	w.flush(deadline)
+	w.render(true)
+
+	return w.pending()
+}
+
+// Wake returns a channel that receives whenever new work is queued for the UI thread
+func (w *Window) Wake() <-chan struct{} {
+	return w.wake
+}
+
+// Stop makes Start return
+func (w *Window) Stop() {
+	w.shutdown()
+
+	if !w.cfg.Headless {
+		UlAppQuit(w.app)
+	}
+}
+
+// pending reports whether anything is waiting to be handed to the page or the view is still loading
+func (w *Window) pending() bool {
+	w.mu.Lock()
+	busy := len(w.tasks) > 0
+
+	for _, s := range w.streams {
+		busy = busy || s.pending()
+	}
+
+	for _, s := range w.syncs {
+		busy = busy || s.pending()
+	}
+	w.mu.Unlock()
+
+	return busy || w.patch.pending() || w.bus.busy() || UlViewIsLoading(w.view)
+}
+
+// run is the frame loop of a headless Window, it renders at most 60 frames per second, slows down according to
+// the power policy and sleeps until new work arrives or the next frame is due
+func (w *Window) run() {
+	frame := time.Second / 60
+	timer := time.NewTimer(frame)
+	defer timer.Stop()
+
+	last := time.Now()
+
+	for {
+		start := time.Now()
+		interval, render := w.throttle()
+
+		if w.cfg.VirtualTime {
+			w.step(start.Sub(last))
+		}
+
+		last = start
+
+		w.flush(start.Add(frame))
+		w.render(render)
+
+		if !timer.Stop() {
+			select {
+			case <-timer.C:
+			default:
+			}
+		}
+
+		// while throttled new work ends the wait early, at full rate it waits for the next frame
+		wake := w.wake
+
+		if interval < frame {
+			interval, wake = frame, nil
+		}
+
+		timer.Reset(interval - time.Since(start))
+
+		select {
+		case <-w.life.Done():
+			return
+		case <-timer.C:
+		case <-wake:
+		}
+	}
+}
@@ -0,0 +1,480 @@
+package muon
+
+import (
+	"bufio"
+	"encoding/binary"
+	"errors"
+	"fmt"
+	"image"
+	"os"
+	"path/filepath"
+	"sync/atomic"
+	"time"
+)
+
+// RecordFormat is the file format a Recorder writes
+type RecordFormat int
+
+const (
+	// RecordY4M writes a YUV4MPEG2 4:2:0 video at a constant frame rate, repeating frames where nothing changed
+	RecordY4M RecordFormat = iota
+	// RecordRaw writes each captured frame as a header of timestamp, width and height followed by straight alpha RGBA
+	RecordRaw
+	// RecordPNG writes a numbered PNG per captured frame into a directory with a timestamps.txt index
+	RecordPNG
+)
+
+// RecorderConfig contains configurable controls for a Recorder
+type RecorderConfig struct {
+	Format RecordFormat
+	// FPS is the highest rate frames are captured at, defaults to 30
+	FPS int
+	// Buffers is the number of frames that may wait for the writer before new ones are dropped, defaults to 8
+	Buffers int
+}
+
+// Recorder captures the frames a headless Window renders and writes them to disk from its own goroutine
+type Recorder struct {
+	frames  uint64
+	dropped uint64
+	end     int64
+	stopped int32
+
+	w      *Window
+	cfg    RecorderConfig
+	path   string
+	start  time.Duration
+	last   time.Duration
+	ring   ring
+	signal chan struct{}
+	done   chan struct{}
+	err    error
+}
+
+type recorded struct {
+	img *image.RGBA
+	at  time.Duration
+}
+
+// ring is a single producer, single consumer queue of pooled frames: the UI thread fills slots and advances head,
+// the writer drains them and advances tail, neither ever waits on the other
+type ring struct {
+	slots []recorded
+	head  uint64
+	tail  uint64
+}
+
+func (r *ring) push(fill func(*recorded)) bool {
+	head, tail := atomic.LoadUint64(&r.head), atomic.LoadUint64(&r.tail)
+
+	if head-tail == uint64(len(r.slots)) {
+		return false
+	}
+
+	fill(&r.slots[head%uint64(len(r.slots))])
+	atomic.StoreUint64(&r.head, head+1)
+
+	return true
+}
+
+func (r *ring) peek() (*recorded, bool) {
+	tail := atomic.LoadUint64(&r.tail)
+
+	if tail == atomic.LoadUint64(&r.head) {
+		return nil, false
+	}
+
+	return &r.slots[tail%uint64(len(r.slots))], true
+}
+
+func (r *ring) pop() {
+	atomic.AddUint64(&r.tail, 1)
+}
+
+// Record starts recording the frames of a headless Window to path, a directory for RecordPNG and a file otherwise.
+// When the writer falls behind, frames are dropped rather than holding up rendering. Frames are timestamped
+// on the Window's virtual clock if it has one.
+func (w *Window) Record(path string, cfg *RecorderConfig) (*Recorder, error) {
+	if !w.cfg.Headless {
+		return nil, errors.New("Record requires a headless Window, windowed views are rendered on the GPU")
+	}
+
+	if cfg == nil {
+		cfg = &RecorderConfig{}
+	}
+
+	r := &Recorder{
+		w:      w,
+		cfg:    *cfg,
+		path:   path,
+		start:  w.elapsed(),
+		signal: make(chan struct{}, 1),
+		done:   make(chan struct{}),
+	}
+
+	if r.cfg.FPS <= 0 {
+		r.cfg.FPS = 30
+	}
+
+	if r.cfg.Buffers <= 0 {
+		r.cfg.Buffers = 8
+	}
+
+	r.ring.slots = make([]recorded, r.cfg.Buffers)
+	r.last = r.start - time.Second
+
+	var err error
+	var out recordWriter
+
+	switch r.cfg.Format {
+	case RecordY4M:
+		out, err = newY4MWriter(path, r.cfg.FPS)
+	case RecordRaw:
+		out, err = newRawWriter(path)
+	case RecordPNG:
+		out, err = newPNGSequence(path)
+	default:
+		err = errors.New("unknown RecordFormat")
+	}
+
+	if err != nil {
+		return nil, err
+	}
+
+	go r.write(out)
+
+	w.post(func() {
+		w.observers = append(w.observers, r.capture)
+	})
+
+	return r, nil
+}
+
+// capture is a frame observer running on the UI thread
+func (r *Recorder) capture(img *image.RGBA) bool {
+	if atomic.LoadInt32(&r.stopped) == 1 {
+		return false
+	}
+
+	now := r.w.elapsed()
+
+	if now-r.last < time.Second/time.Duration(r.cfg.FPS) {
+		return true
+	}
+
+	r.last = now
+
+	ok := r.ring.push(func(slot *recorded) {
+		slot.img = copyRGBA(slot.img, img)
+		slot.at = now - r.start
+	})
+
+	if !ok {
+		atomic.AddUint64(&r.dropped, 1)
+		return true
+	}
+
+	atomic.AddUint64(&r.frames, 1)
+
+	select {
+	case r.signal <- struct{}{}:
+	default:
+	}
+
+	return true
+}
+
+func (r *Recorder) write(out recordWriter) {
+	defer close(r.done)
+
+	for {
+		for {
+			f, ok := r.ring.peek()
+
+			if !ok {
+				break
+			}
+
+			if r.err == nil {
+				r.err = out.frame(f.img, f.at)
+			}
+
+			r.ring.pop()
+		}
+
+		if atomic.LoadInt32(&r.stopped) == 1 {
+			break
+		}
+
+		select {
+		case <-r.signal:
+		case <-r.w.life.Done():
+			r.finish()
+		}
+	}
+
+	if err := out.close(time.Duration(atomic.LoadInt64(&r.end))); r.err == nil {
+		r.err = err
+	}
+}
+
+// finish marks the recording as stopped at the current time
+func (r *Recorder) finish() {
+	if atomic.LoadInt32(&r.stopped) == 0 {
+		atomic.StoreInt64(&r.end, int64(r.w.elapsed()-r.start))
+		atomic.StoreInt32(&r.stopped, 1)
+	}
+}
+
+// Frames returns how many frames have been captured
+func (r *Recorder) Frames() uint64 {
+	return atomic.LoadUint64(&r.frames)
+}
+
+// Dropped returns how many frames were dropped because the writer fell behind
+func (r *Recorder) Dropped() uint64 {
+	return atomic.LoadUint64(&r.dropped)
+}
+
+// Stop ends the recording, waits for every captured frame to be written and returns the first write error.
+// A RecordY4M video is padded with the last frame so that it lasts until Stop was called.
+func (r *Recorder) Stop() error {
+	r.finish()
+
+	select {
+	case r.signal <- struct{}{}:
+	default:
+	}
+
+	<-r.done
+
+	return r.err
+}
+
+type recordWriter interface {
+	frame(img *image.RGBA, at time.Duration) error
+	// close finishes the recording, which was stopped at end
+	close(end time.Duration) error
+}
+
+type fileWriter struct {
+	f   *os.File
+	buf *bufio.Writer
+}
+
+func createFile(path string) (fileWriter, error) {
+	f, err := os.Create(path)
+
+	if err != nil {
+		return fileWriter{}, err
+	}
+
+	return fileWriter{f, bufio.NewWriterSize(f, 1<<20)}, nil
+}
+
+func (fw fileWriter) close(end time.Duration) error {
+	err := fw.buf.Flush()
+
+	if cerr := fw.f.Close(); err == nil {
+		err = cerr
+	}
+
+	return err
+}
+
+type y4mWriter struct {
+	fileWriter
+	fps    int
+	width  int
+	height int
+	n      int
+	last   []byte
+}
+
+func newY4MWriter(path string, fps int) (*y4mWriter, error) {
+	fw, err := createFile(path)
+
+	if err != nil {
+		return nil, err
+	}
+
+	return &y4mWriter{fileWriter: fw, fps: fps}, nil
+}
+
+func (y *y4mWriter) frame(img *image.RGBA, at time.Duration) error {
+	width, height := img.Rect.Dx(), img.Rect.Dy()
+
+	if y.last == nil {
+		y.width, y.height = width, height
+		y.n = int(at * time.Duration(y.fps) / time.Second)
+		fmt.Fprintf(y.buf, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, y.fps)
+	} else if width != y.width || height != y.height {
+		// a Y4M stream has a single size, frames after a resize are left out
+		return nil
+	}
+
+	// repeat the previous frame until the stream's clock catches up with this one
+	index := int(at * time.Duration(y.fps) / time.Second)
+
+	for ; y.last != nil && y.n < index; y.n++ {
+		if err := y.write(); err != nil {
+			return err
+		}
+	}
+
+	y.last = toYUV420(y.last, img)
+	y.n++
+
+	return y.write()
+}
+
+// close repeats the last frame until the stream's clock reaches end
+func (y *y4mWriter) close(end time.Duration) error {
+	index := int(end * time.Duration(y.fps) / time.Second)
+
+	for ; y.last != nil && y.n < index; y.n++ {
+		if err := y.write(); err != nil {
+			y.fileWriter.close(end)
+			return err
+		}
+	}
+
+	return y.fileWriter.close(end)
+}
+
+func (y *y4mWriter) write() error {
+	if _, err := y.buf.WriteString("FRAME\n"); err != nil {
+		return err
+	}
+
+	_, err := y.buf.Write(y.last)
+
+	return err
+}
+
+// toYUV420 converts img to full range BT.601 planar 4:2:0. Premultiplied pixels are already composited onto black.
+func toYUV420(dst []byte, img *image.RGBA) []byte {
+	width, height := img.Rect.Dx(), img.Rect.Dy()
+	cw, ch := (width+1)/2, (height+1)/2
+	size := width*height + 2*cw*ch
+
+	if cap(dst) < size {
+		dst = make([]byte, size)
+	}
+
+	dst = dst[:size]
+	ys, cb, cr := dst[:width*height], dst[width*height:width*height+cw*ch], dst[width*height+cw*ch:]
+
+	parallel(ch, func(from, to int) {
+		for cy := from; cy < to; cy++ {
+			for cx := 0; cx < cw; cx++ {
+				var r, g, b, n int
+
+				for y := cy * 2; y < cy*2+2 && y < height; y++ {
+					for x := cx * 2; x < cx*2+2 && x < width; x++ {
+						p := img.Pix[img.PixOffset(img.Rect.Min.X+x, img.Rect.Min.Y+y):]
+						pr, pg, pb := int(p[0]), int(p[1]), int(p[2])
+
+						ys[y*width+x] = byte((19595*pr + 38470*pg + 7471*pb + 1<<15) >> 16)
+						r, g, b, n = r+pr, g+pg, b+pb, n+1
+					}
+				}
+
+				r, g, b = r/n, g/n, b/n
+
+				cb[cy*cw+cx] = clamp8((-11059*r - 21709*g + 32768*b + 128<<16 + 1<<15) >> 16)
+				cr[cy*cw+cx] = clamp8((32768*r - 27439*g - 5329*b + 128<<16 + 1<<15) >> 16)
+			}
+		}
+	})
+
+	return dst
+}
+
+func clamp8(v int) byte {
+	if v < 0 {
+		return 0
+	}
+
+	if v > 255 {
+		return 255
+	}
+
+	return byte(v)
+}
+
+type rawWriter struct {
+	fileWriter
+}
+
+func newRawWriter(path string) (*rawWriter, error) {
+	fw, err := createFile(path)
+
+	if err != nil {
+		return nil, err
+	}
+
+	return &rawWriter{fw}, nil
+}
+
+func (rw *rawWriter) frame(img *image.RGBA, at time.Duration) error {
+	var header [16]byte
+	binary.LittleEndian.PutUint64(header[0:], uint64(at))
+	binary.LittleEndian.PutUint32(header[8:], uint32(img.Rect.Dx()))
+	binary.LittleEndian.PutUint32(header[12:], uint32(img.Rect.Dy()))
+
+	if _, err := rw.buf.Write(header[:]); err != nil {
+		return err
+	}
+
+	return EncodeRaw(rw.buf, img)
+}
+
+type pngSequence struct {
+	dir   string
+	n     int
+	index fileWriter
+}
+
+func newPNGSequence(dir string) (*pngSequence, error) {
+	if err := os.MkdirAll(dir, 0755); err != nil {
+		return nil, err
+	}
+
+	index, err := createFile(filepath.Join(dir, "timestamps.txt"))
+
+	if err != nil {
+		return nil, err
+	}
+
+	return &pngSequence{dir: dir, index: index}, nil
+}
+
+func (pw *pngSequence) frame(img *image.RGBA, at time.Duration) error {
+	pw.n++
+	name := fmt.Sprintf("frame-%06d.png", pw.n)
+
+	f, err := os.Create(filepath.Join(pw.dir, name))
+
+	if err != nil {
+		return err
+	}
+
+	err = EncodePNG(f, img)
+
+	if cerr := f.Close(); err == nil {
+		err = cerr
+	}
+
+	if err != nil {
+		return err
+	}
+
+	_, err = fmt.Fprintf(pw.index.buf, "%s %d\n", name, at.Nanoseconds()/int64(time.Microsecond))
+
+	return err
+}
+
+func (pw *pngSequence) close(end time.Duration) error {
+	return pw.index.close(end)
+}
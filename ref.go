@@ -0,0 +1,234 @@
+package muon
+
+import (
+	"errors"
+	"reflect"
+	"runtime"
+	"sync/atomic"
+	"unsafe"
+
+	. "github.com/ImVexed/muon/ultralight"
+)
+
+// ErrRefInvalid is returned when a Ref is used after Close or after its page was navigated away from
+var ErrRefInvalid = errors.New("Ref was closed or its page was unloaded")
+
+// Ref holds on to a JS value across calls. The value is protected from the JS garbage collector until Close is
+// called or the Ref itself is garbage collected, and the Ref becomes invalid once the page it came from is unloaded.
+// Like Eval, a Ref must only be used while no other goroutine is using the Window's JS context.
+type Ref struct {
+	w      *Window
+	val    JSValueRef
+	page   uint64
+	closed int32
+}
+
+// EvalRef evaluates a given JavaScript string in the given Window view and keeps a Ref to its result,
+// an exception thrown by js is returned as the error
+func (w *Window) EvalRef(js string) (*Ref, error) {
+	val, err := w.script(js)
+
+	if err != nil {
+		return nil, err
+	}
+
+	return w.newRef(UlViewGetJSContext(w.view), val), nil
+}
+
+func (w *Window) newRef(ctx JSContextRef, val JSValueRef) *Ref {
+	JSValueProtect(ctx, val)
+
+	w.mu.Lock()
+	page := w.pages
+	w.mu.Unlock()
+
+	r := &Ref{
+		w:    w,
+		val:  val,
+		page: page,
+	}
+
+	runtime.SetFinalizer(r, (*Ref).release)
+
+	return r
+}
+
+// Close releases the JS value, it is safe to call Close more than once and from any goroutine
+func (r *Ref) Close() {
+	runtime.SetFinalizer(r, nil)
+	r.release()
+}
+
+// release invalidates the Ref and unprotects its value on the UI thread
+func (r *Ref) release() {
+	if atomic.CompareAndSwapInt32(&r.closed, 0, 1) {
+		w, val := r.w, r.val
+
+		w.post(func() {
+			JSValueUnprotect(UlViewGetJSContext(w.view), val)
+		})
+	}
+}
+
+// object returns the value as an object in the view's current context, or ErrRefInvalid
+func (r *Ref) object() (JSContextRef, JSObjectRef, error) {
+	r.w.mu.Lock()
+	page := r.w.pages
+	r.w.mu.Unlock()
+
+	if page != r.page || atomic.LoadInt32(&r.closed) != 0 {
+		return nil, nil, ErrRefInvalid
+	}
+
+	ctx := UlViewGetJSContext(r.w.view)
+	exc := make([]JSValueRef, 1)
+
+	obj := JSValueToObject(ctx, r.val, exc)
+
+	if exc[0] != nil {
+		return nil, nil, jsError(ctx, exc[0])
+	}
+
+	return ctx, obj, nil
+}
+
+// Value converts the referenced value to a Go value, `ret` is necessary for JSON serialization if it is an object
+func (r *Ref) Value(ret reflect.Type) (interface{}, error) {
+	ctx, obj, err := r.object()
+
+	if err != nil {
+		return nil, err
+	}
+
+	val, err := fromJSValue(ctx, *(*JSValueRef)(unsafe.Pointer(&obj)), ret)
+
+	if err != nil {
+		return nil, err
+	}
+
+	return val.Interface(), nil
+}
+
+// Get reads the property name of the referenced object
+func (r *Ref) Get(name string, ret reflect.Type) (interface{}, error) {
+	ctx, val, err := r.get(name)
+
+	if err != nil {
+		return nil, err
+	}
+
+	rv, err := fromJSValue(ctx, val, ret)
+
+	if err != nil {
+		return nil, err
+	}
+
+	return rv.Interface(), nil
+}
+
+// GetRef reads the property name of the referenced object and keeps a Ref to it
+func (r *Ref) GetRef(name string) (*Ref, error) {
+	ctx, val, err := r.get(name)
+
+	if err != nil {
+		return nil, err
+	}
+
+	return r.w.newRef(ctx, val), nil
+}
+
+func (r *Ref) get(name string) (JSContextRef, JSValueRef, error) {
+	ctx, obj, err := r.object()
+
+	if err != nil {
+		return nil, nil, err
+	}
+
+	str := JSStringCreateWithUTF8CString(name)
+	defer JSStringRelease(str)
+
+	exc := make([]JSValueRef, 1)
+	val := JSObjectGetProperty(ctx, obj, str, exc)
+
+	if exc[0] != nil {
+		return nil, nil, jsError(ctx, exc[0])
+	}
+
+	return ctx, val, nil
+}
+
+// Set assigns value to the property name of the referenced object
+func (r *Ref) Set(name string, value interface{}) error {
+	ctx, obj, err := r.object()
+
+	if err != nil {
+		return err
+	}
+
+	str := JSStringCreateWithUTF8CString(name)
+	defer JSStringRelease(str)
+
+	exc := make([]JSValueRef, 1)
+	JSObjectSetProperty(ctx, obj, str, toJSArg(ctx, value), KJSPropertyAttributeNone, exc)
+
+	if exc[0] != nil {
+		return jsError(ctx, exc[0])
+	}
+
+	return nil
+}
+
+// Call invokes the method of the referenced object, or the referenced function itself if method is empty
+func (r *Ref) Call(method string, ret reflect.Type, args ...interface{}) (interface{}, error) {
+	ctx, obj, err := r.object()
+
+	if err != nil {
+		return nil, err
+	}
+
+	fn, this := obj, JSObjectRef(nil)
+
+	if method != "" {
+		_, val, err := r.get(method)
+
+		if err != nil {
+			return nil, err
+		}
+
+		fn, this = *(*JSObjectRef)(unsafe.Pointer(&val)), obj
+	}
+
+	if !JSValueIsObject(ctx, *(*JSValueRef)(unsafe.Pointer(&fn))) || !JSObjectIsFunction(ctx, fn) {
+		return nil, errors.New(method + " is not a function")
+	}
+
+	vals := make([]JSValueRef, len(args))
+
+	for i, arg := range args {
+		vals[i] = toJSArg(ctx, arg)
+	}
+
+	exc := make([]JSValueRef, 1)
+	res := JSObjectCallAsFunction(ctx, fn, this, uint(len(vals)), vals, exc)
+
+	if exc[0] != nil {
+		return nil, jsError(ctx, exc[0])
+	}
+
+	val, err := fromJSValue(ctx, res, ret)
+
+	if err != nil {
+		return nil, err
+	}
+
+	return val.Interface(), nil
+}
+
+// toJSArg converts a Go value to JS, passing Refs through as the value they hold
+func toJSArg(ctx JSContextRef, arg interface{}) JSValueRef {
+	if ref, ok := arg.(*Ref); ok {
+		return ref.val
+	}
+
+	return toJSValue(ctx, reflect.ValueOf(arg))
+}
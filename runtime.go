@@ -0,0 +1,404 @@
+package muon
+
+// runtimeJS is the resident JS half of the bridge, injected into every page before any muon feature is used
+const runtimeJS = `(function (g) {
+	if (g.muon) {
+		return;
+	}
+
+	var muon = g.muon = {
+		streams: {},
+		calls: {},
+		state: {}
+	};
+
+	var seq = 0;
+
+	// settle is called from Go once an async call has finished
+	muon.settle = function (id, ok, value) {
+		var c = muon.calls[id];
+
+		if (!c) {
+			return;
+		}
+
+		delete muon.calls[id];
+
+		if (ok) {
+			c.resolve(value);
+		} else {
+			c.reject(new Error(value));
+		}
+	};
+
+	var listeners = {};
+
+	// on registers fn to receive payloads sent with Window.Emit on topic and returns a function removing it again
+	muon.on = function (topic, fn) {
+		(listeners[topic] = listeners[topic] || []).push(fn);
+
+		return function () {
+			muon.off(topic, fn);
+		};
+	};
+
+	muon.off = function (topic, fn) {
+		var fns = listeners[topic] || [];
+		var i = fns.indexOf(fn);
+
+		if (i >= 0) {
+			fns.splice(i, 1);
+		}
+	};
+
+	// dispatch receives every topic emitted during a tick at once
+	muon.dispatch = function (events) {
+		for (var topic in events) {
+			var fns = (listeners[topic] || []).slice();
+
+			for (var i = 0; i < fns.length; i++) {
+				try {
+					fns[i](events[topic]);
+				} catch (e) {
+					console.error(e);
+				}
+			}
+		}
+	};
+
+	// bind installs the JS stub for a binding whose native function lives under the global native.
+	// Every crossing into the native function is prefixed with the [dropped, merged] counts since the last one.
+	muon.bind = function (name, native, opts) {
+		var counts = { dropped: 0, merged: 0 };
+
+		var header = function () {
+			var h = [counts.dropped, counts.merged];
+			counts.dropped = counts.merged = 0;
+			return h;
+		};
+
+		var call = function (args) {
+			return g[native].apply(null, [header()].concat(args));
+		};
+
+		if (opts.batched) {
+			call = batch(native, header);
+		} else if (opts.async) {
+			call = function (args) {
+				var signal = opts.context && isSignal(args[args.length - 1]) ? args.pop() : null;
+
+				return new Promise(function (resolve, reject) {
+					if (signal && signal.aborted) {
+						reject(abortError(signal));
+						return;
+					}
+
+					var id = ++seq;
+					muon.calls[id] = { resolve: resolve, reject: reject };
+
+					if (signal) {
+						signal.addEventListener("abort", function () {
+							if (muon.calls[id]) {
+								delete muon.calls[id];
+								reject(abortError(signal));
+								g["__muon:abort"](id);
+							}
+						});
+					}
+
+					try {
+						g[native].apply(null, [header(), id].concat(args));
+					} catch (e) {
+						delete muon.calls[id];
+						reject(e);
+					}
+				});
+			};
+		}
+
+		if (opts.limit) {
+			call = limit(opts, call, counts);
+		}
+
+		g[name] = function () {
+			return call(Array.prototype.slice.call(arguments));
+		};
+	};
+
+	function isSignal(v) {
+		return v !== null && typeof v === "object" && typeof v.aborted === "boolean" && typeof v.addEventListener === "function";
+	}
+
+	function abortError(signal) {
+		if (signal.reason !== undefined) {
+			return signal.reason;
+		}
+
+		var e = new Error("The call was aborted");
+		e.name = "AbortError";
+		return e;
+	}
+
+	// batch queues calls made within a task and sends them to Go in one crossing from a microtask
+	function batch(native, header) {
+		var queue = [];
+
+		var flush = function () {
+			var calls = queue;
+			queue = [];
+
+			var results;
+
+			try {
+				results = g[native](header(), calls.map(function (c) {
+					return c.args;
+				}));
+			} catch (e) {
+				calls.forEach(function (c) {
+					c.reject(e);
+				});
+				return;
+			}
+
+			calls.forEach(function (c, i) {
+				var r = results[i] || [false, "no result"];
+
+				if (r[0]) {
+					c.resolve(r[1]);
+				} else {
+					c.reject(new Error(r[1]));
+				}
+			});
+		};
+
+		return function (args) {
+			return new Promise(function (resolve, reject) {
+				if (queue.length === 0) {
+					Promise.resolve().then(flush);
+				}
+
+				queue.push({ args: args, resolve: resolve, reject: reject });
+			});
+		};
+	}
+
+	// limit throttles, debounces or coalesces calls before they reach Go, superseded calls settle with the result of the call that replaced them
+	function limit(opts, call, counts) {
+		var pending = null, timer = null, last = 0;
+
+		var frame = g.requestAnimationFrame ? function (fn) {
+			return g.requestAnimationFrame(fn);
+		} : function (fn) {
+			return setTimeout(fn, 0);
+		};
+
+		var fire = function () {
+			var p = pending;
+			pending = null;
+			timer = null;
+			last = Date.now();
+
+			var result;
+
+			try {
+				result = Promise.resolve(call(p.args));
+			} catch (e) {
+				result = Promise.reject(e);
+			}
+
+			result.then(function (v) {
+				p.waiters.forEach(function (w) {
+					w.resolve(v);
+				});
+			}, function (e) {
+				p.waiters.forEach(function (w) {
+					w.reject(e);
+				});
+			});
+		};
+
+		return function (args) {
+			return new Promise(function (resolve, reject) {
+				if (pending) {
+					pending.args = args;
+					if (opts.limit === "coalesce") {
+						counts.merged++;
+					} else {
+						counts.dropped++;
+					}
+				} else {
+					pending = { args: args, waiters: [] };
+				}
+
+				pending.waiters.push({ resolve: resolve, reject: reject });
+
+				if (opts.limit === "debounce") {
+					clearTimeout(timer);
+					timer = setTimeout(fire, opts.interval);
+				} else if (opts.limit === "throttle") {
+					if (timer === null) {
+						var wait = last + opts.interval - Date.now();
+
+						if (wait <= 0) {
+							fire();
+						} else {
+							timer = setTimeout(fire, wait);
+						}
+					}
+				} else if (timer === null) {
+					timer = frame(fire);
+				}
+			});
+		};
+	}
+
+	// sync applies the [path, value] assignments and [path] deletions committed to a Window.Sync state,
+	// then notifies listeners registered with muon.on("sync:" + name, fn)
+	muon.sync = function (name, ops) {
+		for (var i = 0; i < ops.length; i++) {
+			var path = ops[i][0];
+
+			if (path.length === 0) {
+				muon.state[name] = g[name] = ops[i][1];
+				continue;
+			}
+
+			var target = muon.state[name];
+
+			for (var j = 0; j < path.length - 1 && target != null; j++) {
+				target = target[path[j]];
+			}
+
+			if (target == null) {
+				continue;
+			}
+
+			if (ops[i].length > 1) {
+				target[path[path.length - 1]] = ops[i][1];
+			} else {
+				delete target[path[path.length - 1]];
+			}
+		}
+
+		var events = {};
+		events["sync:" + name] = muon.state[name];
+		muon.dispatch(events);
+	};
+
+	// patch applies the DOM operations queued on a Window's Patch, encoded as unit separated
+	// [op, target, arg, value] groups
+	muon.patch = function (encoded) {
+		var f = encoded.split("\x1f"), found = {};
+
+		var find = function (target) {
+			if (found[target]) {
+				return found[target];
+			}
+
+			var els;
+
+			if (/^#[\w-]+$/.test(target)) {
+				var el = document.getElementById(target.slice(1));
+				els = el ? [el] : [];
+			} else {
+				els = document.querySelectorAll(target);
+			}
+
+			return found[target] = els;
+		};
+
+		for (var i = 0; i + 3 < f.length; i += 4) {
+			var op = +f[i], els = find(f[i + 1]), arg = f[i + 2], value = f[i + 3];
+
+			for (var j = 0; j < els.length; j++) {
+				switch (op) {
+					case 0: els[j].textContent = value; break;
+					case 1: els[j].setAttribute(arg, value); break;
+					case 2: els[j].removeAttribute(arg); break;
+					case 3: els[j].innerHTML = value; break;
+					case 4: els[j].classList.add(arg); break;
+					case 5: els[j].classList.remove(arg); break;
+				}
+			}
+
+			// replacing markup can add or remove matches for any selector
+			if (op === 3) {
+				found = {};
+			}
+		}
+	};
+
+	// await reports the outcome of a Promise awaited by Window.EvalAwait or Window.CallAwait back to Go
+	muon.await = function (promise, id) {
+		Promise.resolve(promise).then(function (value) {
+			g["__muon:settle"](id, true, value);
+		}, function (e) {
+			g["__muon:settle"](id, false, e);
+		});
+	};
+
+	// stream creates the async iterable that Window.Stream delivers batches into
+	muon.stream = function (name) {
+		var queue = [], head = 0, waiters = [], done = false;
+
+		var s = {
+			get pending() {
+				return queue.length - head;
+			},
+			push: function (batch) {
+				if (done) {
+					return;
+				}
+
+				for (var i = 0; i < batch.length; i++) {
+					if (waiters.length > 0) {
+						waiters.shift()({ value: batch[i], done: false });
+					} else {
+						queue.push(batch[i]);
+					}
+				}
+			},
+			end: function () {
+				done = true;
+
+				while (waiters.length > 0) {
+					waiters.shift()({ value: undefined, done: true });
+				}
+			},
+			next: function () {
+				if (head < queue.length) {
+					var value = queue[head];
+					queue[head++] = undefined;
+
+					if (head === queue.length) {
+						queue = [];
+						head = 0;
+					}
+
+					return Promise.resolve({ value: value, done: false });
+				}
+
+				if (done) {
+					return Promise.resolve({ value: undefined, done: true });
+				}
+
+				return new Promise(function (resolve) {
+					waiters.push(resolve);
+				});
+			},
+			return: function () {
+				s.end();
+				queue = [];
+				head = 0;
+				return Promise.resolve({ value: undefined, done: true });
+			}
+		};
+
+		s[Symbol.asyncIterator] = function () {
+			return s;
+		};
+
+		muon.streams[name] = g[name] = s;
+	};
+})(this);
+`
@@ -0,0 +1,131 @@
+package muon
+
+import (
+	"strconv"
+	"time"
+
+	. "github.com/ImVexed/muon/ultralight"
+)
+
+// AdaptiveResolution lowers the resolution a headless Window renders at while frames take longer than Budget,
+// and raises it again once load drops. The rendered bitmap becomes smaller and is expected to be upscaled when
+// composited. The view is resized and the page zoomed out with CSS zoom by the same factor, which keeps most
+// layouts in place but is visible to the page: innerWidth, vw/vh units and media queries see the smaller viewport.
+type AdaptiveResolution struct {
+	// Budget is the time a frame's update and render may take, defaults to 1/60s
+	Budget time.Duration
+	// MinScale is the lowest fraction of the Window's size rendered, defaults to 0.5
+	MinScale float64
+	// Step is how much the scale changes at a time, defaults to 0.125
+	Step float64
+}
+
+type scaler struct {
+	scale float64
+	avg   time.Duration
+	calm  int
+}
+
+// RenderScale returns the fraction of the Window's size that is currently being rendered
+func (w *Window) RenderScale() float64 {
+	if w.scaler.scale == 0 {
+		return 1
+	}
+
+	return w.scaler.scale
+}
+
+// render updates the renderer and optionally paints, feeding the frame time to the adaptive resolution
+// and the new frame to its observers
+func (w *Window) render(paint bool) {
+	start := time.Now()
+
+	UlUpdate(w.renderer)
+
+	if !paint {
+		return
+	}
+
+	UlRender(w.renderer)
+
+	if a := w.cfg.Adaptive; a != nil && w.scaler.adapt(a, time.Since(start)) {
+		w.rescale()
+	}
+
+	w.observe()
+}
+
+// adapt feeds a frame time to the scaler and reports whether the scale changed
+func (s *scaler) adapt(a *AdaptiveResolution, took time.Duration) bool {
+	budget, min, step := a.Budget, a.MinScale, a.Step
+
+	if budget <= 0 {
+		budget = time.Second / 60
+	}
+
+	if min <= 0 || min > 1 {
+		min = 0.5
+	}
+
+	if step <= 0 {
+		step = 0.125
+	}
+
+	if s.scale == 0 {
+		s.scale, s.avg = 1, took
+	}
+
+	// an exponential moving average over roughly the last 8 frames
+	s.avg += (took - s.avg) / 8
+
+	scale := s.scale
+
+	switch {
+	case s.avg > budget && scale > min:
+		scale -= step
+		s.calm = 0
+	case s.avg < budget/2:
+		// restore sharpness only after load has stayed low for a while
+		if s.calm++; s.calm >= 60 && scale < 1 {
+			scale += step
+			s.calm = 0
+		}
+	default:
+		s.calm = 0
+	}
+
+	if scale < min {
+		scale = min
+	}
+
+	if scale > 1 {
+		scale = 1
+	}
+
+	if scale == s.scale {
+		return false
+	}
+
+	s.scale = scale
+	// frame times at the new size are not comparable to the old ones
+	s.avg = budget / 2
+
+	return true
+}
+
+// renderSize returns the size the view is rendered at
+func (w *Window) renderSize() (uint32, uint32) {
+	scale := w.RenderScale()
+
+	return uint32(float64(w.cfg.Width)*scale + 0.5), uint32(float64(w.cfg.Height)*scale + 0.5)
+}
+
+// rescale renders the view at the current scale with the page zoomed to fit
+func (w *Window) rescale() {
+	scale := w.RenderScale()
+	width, height := w.renderSize()
+
+	UlViewResize(w.view, width, height)
+
+	w.inject("scale", "document.documentElement.style.zoom = "+strconv.FormatFloat(scale, 'f', -1, 64))
+}
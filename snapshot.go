@@ -0,0 +1,113 @@
+package muon
+
+import (
+	"image"
+
+	. "github.com/ImVexed/muon/ultralight"
+)
+
+// Frame is a zero-copy view of a headless Window's rendered pixels, premultiplied RGBA like image.RGBA.
+// The pixels are locked until Close and must not be used after it.
+type Frame struct {
+	*image.RGBA
+	bitmap ULBitmap
+}
+
+// Close unlocks the Frame's pixels
+func (f *Frame) Close() {
+	if f.bitmap == nil {
+		return
+	}
+
+	UlBitmapUnlockPixels(f.bitmap)
+	f.bitmap = nil
+	f.RGBA = nil
+}
+
+// Snapshot returns the pixels rendered by the last Pump, or false if nothing changed since the previous Snapshot.
+// Like Pump it must be called from the OS thread that called New, and the Frame must be closed before the next Pump.
+func (w *Window) Snapshot() (*Frame, bool) {
+	bitmap, ok := w.bitmap()
+
+	if !ok {
+		return nil, false
+	}
+
+	return &Frame{
+		RGBA:   lockRGBA(bitmap),
+		bitmap: bitmap,
+	}, true
+}
+
+// SnapshotInto copies the pixels rendered by the last Pump into dst, reusing its buffer when it is large enough,
+// and returns the resulting image. It returns dst and false if nothing changed since the previous Snapshot.
+// Like Pump it must be called from the OS thread that called New.
+func (w *Window) SnapshotInto(dst *image.RGBA) (*image.RGBA, bool) {
+	bitmap, ok := w.bitmap()
+
+	if !ok {
+		return dst, false
+	}
+
+	src := lockRGBA(bitmap)
+	defer UlBitmapUnlockPixels(bitmap)
+
+	return copyRGBA(dst, src), true
+}
+
+// copyRGBA copies src into dst with tightly packed rows, reusing dst's buffer when it is large enough
+func copyRGBA(dst, src *image.RGBA) *image.RGBA {
+	r := src.Rect
+	n := r.Dx() * r.Dy() * 4
+
+	if dst == nil || cap(dst.Pix) < n {
+		dst = image.NewRGBA(r)
+	} else {
+		dst.Pix, dst.Stride, dst.Rect = dst.Pix[:n], r.Dx()*4, r
+	}
+
+	if src.Stride == dst.Stride {
+		copy(dst.Pix, src.Pix)
+		return dst
+	}
+
+	for y := 0; y < r.Dy(); y++ {
+		copy(dst.Pix[y*dst.Stride:(y+1)*dst.Stride], src.Pix[y*src.Stride:])
+	}
+
+	return dst
+}
+
+// bitmap returns the view's bitmap if it changed since it was last read
+func (w *Window) bitmap() (ULBitmap, bool) {
+	if !w.cfg.Headless {
+		panic("Snapshot requires a headless Window, windowed views are rendered on the GPU")
+	}
+
+	if !UlViewIsBitmapDirty(w.view) {
+		return nil, false
+	}
+
+	bitmap := UlViewGetBitmap(w.view)
+
+	if bitmap == nil || UlBitmapIsEmpty(bitmap) || UlBitmapGetFormat(bitmap) != KBitmapFormat_RGBA8 {
+		return nil, false
+	}
+
+	return bitmap, true
+}
+
+// lockRGBA locks bitmap's pixels and wraps them without copying
+func lockRGBA(bitmap ULBitmap) *image.RGBA {
+	width, height := int(UlBitmapGetWidth(bitmap)), int(UlBitmapGetHeight(bitmap))
+	stride := int(UlBitmapGetRowBytes(bitmap))
+	size := int(UlBitmapGetSize(bitmap))
+
+	pixels := UlBitmapLockPixels(bitmap)
+
+	return &image.RGBA{
+		Pix:    (*[1 << 30]byte)(pixels)[:size:size],
+		Stride: stride,
+		Rect:   image.Rect(0, 0, width, height),
+	}
+}
@@ -0,0 +1,236 @@
+package muon
+
+import (
+	"errors"
+	"reflect"
+	"strconv"
+	"sync"
+
+	. "github.com/ImVexed/muon/ultralight"
+)
+
+// StreamPolicy decides what happens to a value sent while a stream is at its high-water mark
+type StreamPolicy int
+
+const (
+	// StreamBlock stops receiving from the channel until the JS consumer catches up
+	StreamBlock StreamPolicy = iota
+	// StreamDropOldest discards the oldest undelivered value to make room
+	StreamDropOldest
+	// StreamDropNewest discards the value that was just received
+	StreamDropNewest
+)
+
+// StreamConfig contains configurable controls for a Go to JS stream
+type StreamConfig struct {
+	// HighWaterMark is the maximum number of values buffered on each side, defaults to 1024. Up to HighWaterMark
+	// values wait in Go while as many are queued in the page, so at most twice as many are held in total.
+	HighWaterMark int
+	Policy        StreamPolicy
+}
+
+type stream struct {
+	name   string
+	hwm    int
+	policy StreamPolicy
+
+	mu      sync.Mutex
+	cond    *sync.Cond
+	buf     []reflect.Value
+	closed  bool
+	ended   bool
+	dropped uint64
+	stopped bool
+	wake    func()
+	// done is closed with the Window, receive stops then
+	done <-chan struct{}
+}
+
+// Stream exposes the values received from ch as a JS async iterable named `name`.
+// Values are delivered in batches once per update tick; when the page falls behind by more than the
+// configured high-water mark, Stream stops receiving from ch or drops values according to the policy.
+func (w *Window) Stream(name string, ch interface{}, cfg *StreamConfig) error {
+	cv := reflect.ValueOf(ch)
+
+	if cv.Kind() != reflect.Chan || cv.Type().ChanDir()&reflect.RecvDir == 0 {
+		return errors.New("Stream requires a receivable channel")
+	}
+
+	if cfg == nil {
+		cfg = &StreamConfig{}
+	}
+
+	s := &stream{
+		name:   name,
+		hwm:    cfg.HighWaterMark,
+		policy: cfg.Policy,
+		wake:   w.signal,
+		done:   w.life.Done(),
+	}
+
+	if s.hwm <= 0 {
+		s.hwm = 1024
+	}
+
+	s.cond = sync.NewCond(&s.mu)
+
+	w.mu.Lock()
+	if _, ok := w.streams[name]; ok {
+		w.mu.Unlock()
+		return errors.New("Stream " + name + " already exists")
+	}
+	w.streams[name] = s
+	w.mu.Unlock()
+
+	w.inject("stream:"+name, "muon.stream("+strconv.Quote(name)+")")
+
+	go s.receive(cv)
+
+	return nil
+}
+
+// StreamDropped returns how many values the named stream has discarded under a drop policy
+func (w *Window) StreamDropped(name string) uint64 {
+	w.mu.Lock()
+	s, ok := w.streams[name]
+	w.mu.Unlock()
+
+	if !ok {
+		return 0
+	}
+
+	s.mu.Lock()
+	defer s.mu.Unlock()
+
+	return s.dropped
+}
+
+func (s *stream) receive(ch reflect.Value) {
+	cases := []reflect.SelectCase{
+		{Dir: reflect.SelectRecv, Chan: ch},
+		{Dir: reflect.SelectRecv, Chan: reflect.ValueOf(s.done)},
+	}
+
+	for {
+		chosen, v, ok := reflect.Select(cases)
+
+		if chosen == 1 {
+			return
+		}
+
+		s.mu.Lock()
+
+		if !ok {
+			s.closed = true
+			s.mu.Unlock()
+			s.wake()
+			return
+		}
+
+		for s.policy == StreamBlock && len(s.buf) >= s.hwm && !s.stopped {
+			s.cond.Wait()
+		}
+
+		if s.stopped {
+			s.mu.Unlock()
+			return
+		}
+
+		if len(s.buf) >= s.hwm {
+			s.dropped++
+
+			if s.policy == StreamDropNewest {
+				s.mu.Unlock()
+				continue
+			}
+
+			s.buf = s.buf[1:]
+		}
+
+		s.buf = append(s.buf, v)
+		s.mu.Unlock()
+
+		s.wake()
+	}
+}
+
+// stop makes receive return, including while it waits for the JS consumer under StreamBlock
+func (s *stream) stop() {
+	s.mu.Lock()
+	s.stopped = true
+	s.cond.Broadcast()
+	s.mu.Unlock()
+}
+
+// flush hands as many buffered values to JS as it has room for, must be called on the UI thread
+func (s *stream) flush(ctx JSContextRef) {
+	obj := jsLookup(ctx, "muon", "streams", s.name)
+
+	if obj == nil {
+		return
+	}
+
+	s.mu.Lock()
+
+	if s.ended || (len(s.buf) == 0 && !s.closed) {
+		s.mu.Unlock()
+		return
+	}
+
+	l := JSStringCreateWithUTF8CString("pending")
+	pending := int(JSValueToNumber(ctx, JSObjectGetProperty(ctx, obj, l, nil), nil))
+	JSStringRelease(l)
+
+	n := s.hwm - pending
+
+	if n > len(s.buf) {
+		n = len(s.buf)
+	}
+
+	var batch []reflect.Value
+
+	if n > 0 {
+		batch = s.buf[:n:n]
+		s.buf = s.buf[n:]
+		s.cond.Broadcast()
+	}
+
+	end := s.closed && len(s.buf) == 0
+	s.ended = end
+
+	s.mu.Unlock()
+
+	if len(batch) > 0 {
+		vals := make([]JSValueRef, len(batch))
+
+		for i, v := range batch {
+			vals[i] = toJSValue(ctx, v)
+		}
+
+		jsCall(ctx, []string{"muon", "streams", s.name, "push"}, jsArray(ctx, vals))
+	}
+
+	if end {
+		jsCall(ctx, []string{"muon", "streams", s.name, "end"})
+	}
+}
+
+func (s *stream) pending() bool {
+	s.mu.Lock()
+	defer s.mu.Unlock()
+
+	return !s.ended && (len(s.buf) > 0 || s.closed)
+}
+
+func (w *Window) flushStreams(ctx JSContextRef) {
+	w.mu.Lock()
+	streams := make([]*stream, 0, len(w.streams))
+	for _, s := range w.streams {
+		streams = append(streams, s)
+	}
+	w.mu.Unlock()
+
+	for _, s := range streams {
+		s.flush(ctx)
+	}
+}
@@ -0,0 +1,356 @@
+package muon
+
+import (
+	"errors"
+	"reflect"
+	"sync"
+
+	. "github.com/ImVexed/muon/ultralight"
+)
+
+// Synced mirrors a Go value into the JS object `muon.state[name]`, also reachable as the global `name`
+type Synced struct {
+	name  string
+	state reflect.Value
+
+	mu       sync.Mutex
+	snapshot reflect.Value
+	ops      []syncOp
+	full     bool
+	wake     func()
+}
+
+// syncOp assigns value to path, or deletes path when value is invalid
+type syncOp struct {
+	path  []interface{}
+	value reflect.Value
+	del   bool
+}
+
+// Sync starts mirroring the value state points to into the page. The whole value is sent on the next update tick
+// and again whenever a new page is loaded; afterwards only the paths changed between Commits are applied.
+func (w *Window) Sync(name string, state interface{}) (*Synced, error) {
+	v := reflect.ValueOf(state)
+
+	if v.Kind() != reflect.Ptr || v.IsNil() {
+		return nil, errors.New("Sync requires a non-nil pointer")
+	}
+
+	s := &Synced{
+		name:  name,
+		state: v.Elem(),
+		full:  true,
+		wake:  w.signal,
+	}
+
+	s.snapshot = deepCopy(s.state)
+
+	w.mu.Lock()
+	if w.syncs == nil {
+		w.syncs = make(map[string]*Synced)
+	}
+	w.syncs[name] = s
+	w.mu.Unlock()
+
+	return s, nil
+}
+
+// Commit diffs the state against what was last committed and queues the changed paths for the next update tick.
+// The state must not be mutated concurrently with Commit.
+func (s *Synced) Commit() {
+	cur := deepCopy(s.state)
+
+	s.mu.Lock()
+	defer s.mu.Unlock()
+
+	if !s.full {
+		s.ops = diff(s.ops, nil, s.snapshot, cur)
+	}
+
+	s.snapshot = cur
+
+	if len(s.ops) > 0 {
+		s.wake()
+	}
+}
+
+func (s *Synced) pending() bool {
+	s.mu.Lock()
+	defer s.mu.Unlock()
+
+	return s.full || len(s.ops) > 0
+}
+
+// flush applies the queued changes to the page, must be called on the UI thread
+func (s *Synced) flush(ctx JSContextRef) {
+	s.mu.Lock()
+
+	ops := s.ops
+	s.ops = nil
+
+	if s.full {
+		ops = []syncOp{{value: s.snapshot}}
+		s.full = false
+	}
+
+	s.mu.Unlock()
+
+	if len(ops) == 0 {
+		return
+	}
+
+	vals := make([]JSValueRef, len(ops))
+
+	for i, op := range ops {
+		path := make([]JSValueRef, len(op.path))
+
+		for j, p := range op.path {
+			if idx, ok := p.(int); ok {
+				path[j] = JSValueMakeNumber(ctx, float64(idx))
+			} else {
+				str := JSStringCreateWithUTF8CString(p.(string))
+				path[j] = JSValueMakeString(ctx, str)
+				JSStringRelease(str)
+			}
+		}
+
+		if op.del {
+			vals[i] = jsArray(ctx, []JSValueRef{jsArray(ctx, path)})
+		} else {
+			vals[i] = jsArray(ctx, []JSValueRef{jsArray(ctx, path), toSyncValue(ctx, op.value)})
+		}
+	}
+
+	str := JSStringCreateWithUTF8CString(s.name)
+	name := JSValueMakeString(ctx, str)
+	JSStringRelease(str)
+
+	jsCall(ctx, []string{"muon", "sync"}, name, jsArray(ctx, vals))
+}
+
+// resend makes the next flush send the whole state, used when the page has been replaced
+func (s *Synced) resend() {
+	s.mu.Lock()
+	s.full = true
+	s.ops = nil
+	s.mu.Unlock()
+}
+
+func (w *Window) flushSyncs(ctx JSContextRef) {
+	w.mu.Lock()
+	syncs := make([]*Synced, 0, len(w.syncs))
+	for _, s := range w.syncs {
+		syncs = append(syncs, s)
+	}
+	w.mu.Unlock()
+
+	for _, s := range syncs {
+		s.flush(ctx)
+	}
+}
+
+// diff appends the operations turning old into cur to ops
+func diff(ops []syncOp, path []interface{}, old reflect.Value, cur reflect.Value) []syncOp {
+	set := func() []syncOp {
+		return append(ops, syncOp{path: path, value: cur})
+	}
+
+	at := func(p interface{}) []interface{} {
+		return append(path[:len(path):len(path)], p)
+	}
+
+	if old.IsValid() != cur.IsValid() || (cur.IsValid() && old.Type() != cur.Type()) {
+		return set()
+	}
+
+	if !cur.IsValid() {
+		return ops
+	}
+
+	switch cur.Kind() {
+	case reflect.Ptr, reflect.Interface:
+		if old.IsNil() || cur.IsNil() {
+			if old.IsNil() == cur.IsNil() {
+				return ops
+			}
+			return set()
+		}
+
+		return diff(ops, path, old.Elem(), cur.Elem())
+	case reflect.Struct:
+		if !plainJSON(cur.Type()) {
+			if !equal(old, cur) {
+				return set()
+			}
+			return ops
+		}
+
+		for _, f := range jsonFields(cur.Type()) {
+			ov, cv := old.FieldByIndex(f.index), cur.FieldByIndex(f.index)
+
+			if f.omitEmpty && isEmpty(cv) {
+				if !isEmpty(ov) {
+					ops = append(ops, syncOp{path: at(f.name), del: true})
+				}
+				continue
+			}
+
+			if f.omitEmpty && isEmpty(ov) {
+				ops = append(ops, syncOp{path: at(f.name), value: cv})
+				continue
+			}
+
+			ops = diff(ops, at(f.name), ov, cv)
+		}
+	case reflect.Map:
+		if !plainJSON(cur.Type()) || old.IsNil() != cur.IsNil() {
+			if !equal(old, cur) {
+				return set()
+			}
+			return ops
+		}
+
+		iter := old.MapRange()
+
+		for iter.Next() {
+			if !cur.MapIndex(iter.Key()).IsValid() {
+				ops = append(ops, syncOp{path: at(iter.Key().String()), del: true})
+			}
+		}
+
+		iter = cur.MapRange()
+
+		for iter.Next() {
+			ov := old.MapIndex(iter.Key())
+
+			if !ov.IsValid() {
+				ops = append(ops, syncOp{path: at(iter.Key().String()), value: iter.Value()})
+				continue
+			}
+
+			ops = diff(ops, at(iter.Key().String()), ov, iter.Value())
+		}
+	case reflect.Slice, reflect.Array:
+		if !plainJSON(cur.Type()) {
+			if !equal(old, cur) {
+				return set()
+			}
+			return ops
+		}
+
+		if cur.Kind() == reflect.Slice && old.IsNil() != cur.IsNil() {
+			return set()
+		}
+
+		n := old.Len()
+
+		if cur.Len() < n {
+			n = cur.Len()
+		}
+
+		for i := 0; i < n; i++ {
+			ops = diff(ops, at(i), old.Index(i), cur.Index(i))
+		}
+
+		for i := n; i < cur.Len(); i++ {
+			ops = append(ops, syncOp{path: at(i), value: cur.Index(i)})
+		}
+
+		if cur.Len() < old.Len() {
+			ops = append(ops, syncOp{path: at("length"), value: reflect.ValueOf(cur.Len())})
+		}
+	default:
+		if !equal(old, cur) {
+			return set()
+		}
+	}
+
+	return ops
+}
+
+// equal compares two values of the same type, treating values that cannot be inspected as changed
+func equal(a reflect.Value, b reflect.Value) bool {
+	switch a.Kind() {
+	case reflect.Bool:
+		return a.Bool() == b.Bool()
+	case reflect.Int, reflect.Int8, reflect.Int16, reflect.Int32, reflect.Int64:
+		return a.Int() == b.Int()
+	case reflect.Uint, reflect.Uint8, reflect.Uint16, reflect.Uint32, reflect.Uint64, reflect.Uintptr:
+		return a.Uint() == b.Uint()
+	case reflect.Float32, reflect.Float64:
+		return a.Float() == b.Float()
+	case reflect.String:
+		return a.String() == b.String()
+	}
+
+	if !a.CanInterface() || !b.CanInterface() {
+		return false
+	}
+
+	return reflect.DeepEqual(a.Interface(), b.Interface())
+}
+
+// deepCopy copies v so that later mutations of the original are not visible through the copy.
+// Unexported struct fields are copied shallowly.
+func deepCopy(v reflect.Value) reflect.Value {
+	switch v.Kind() {
+	case reflect.Ptr:
+		if v.IsNil() {
+			return v
+		}
+
+		cp := reflect.New(v.Type().Elem())
+		cp.Elem().Set(deepCopy(v.Elem()))
+		return cp
+	case reflect.Interface:
+		if v.IsNil() {
+			return v
+		}
+
+		cp := reflect.New(v.Type()).Elem()
+		cp.Set(deepCopy(v.Elem()))
+		return cp
+	case reflect.Struct:
+		cp := reflect.New(v.Type()).Elem()
+		cp.Set(v)
+
+		for i := 0; i < v.NumField(); i++ {
+			if cp.Field(i).CanSet() {
+				cp.Field(i).Set(deepCopy(v.Field(i)))
+			}
+		}
+		return cp
+	case reflect.Map:
+		if v.IsNil() {
+			return v
+		}
+
+		cp := reflect.MakeMapWithSize(v.Type(), v.Len())
+		iter := v.MapRange()
+
+		for iter.Next() {
+			cp.SetMapIndex(iter.Key(), deepCopy(iter.Value()))
+		}
+		return cp
+	case reflect.Slice:
+		if v.IsNil() {
+			return v
+		}
+
+		cp := reflect.MakeSlice(v.Type(), v.Len(), v.Len())
+
+		for i := 0; i < v.Len(); i++ {
+			cp.Index(i).Set(deepCopy(v.Index(i)))
+		}
+		return cp
+	case reflect.Array:
+		cp := reflect.New(v.Type()).Elem()
+
+		for i := 0; i < v.Len(); i++ {
+			cp.Index(i).Set(deepCopy(v.Index(i)))
+		}
+		return cp
+	}
+
+	return v
+}
@@ -0,0 +1,67 @@
+package muon
+
+import (
+	"sync"
+	"unsafe"
+
+	. "github.com/ImVexed/muon/ultralight"
+)
+
+// viewEvents are the load callbacks of a single view
+type viewEvents struct {
+	beginLoading  func()
+	finishLoading func()
+	domReady      func()
+}
+
+// views routes load callbacks to their owner by view, since the generated bindings only ever hold on to the
+// first callback of each type
+var views = struct {
+	sync.RWMutex
+	m map[ULView]*viewEvents
+}{m: make(map[ULView]*viewEvents)}
+
+func registerView(view ULView, events *viewEvents) {
+	views.Lock()
+	views.m[view] = events
+	views.Unlock()
+
+	UlViewSetBeginLoadingCallback(view, viewBeginLoading, nil)
+	UlViewSetFinishLoadingCallback(view, viewFinishLoading, nil)
+	UlViewSetDOMReadyCallback(view, viewDOMReady, nil)
+}
+
+func unregisterView(view ULView) {
+	views.Lock()
+	delete(views.m, view)
+	views.Unlock()
+}
+
+func viewEventsOf(view ULView) *viewEvents {
+	views.RLock()
+	defer views.RUnlock()
+
+	if ev, ok := views.m[view]; ok {
+		return ev
+	}
+
+	return &viewEvents{}
+}
+
+func viewBeginLoading(userData unsafe.Pointer, caller ULView) {
+	if fn := viewEventsOf(caller).beginLoading; fn != nil {
+		fn()
+	}
+}
+
+func viewFinishLoading(userData unsafe.Pointer, caller ULView) {
+	if fn := viewEventsOf(caller).finishLoading; fn != nil {
+		fn()
+	}
+}
+
+func viewDOMReady(userData unsafe.Pointer, caller ULView) {
+	if fn := viewEventsOf(caller).domReady; fn != nil {
+		fn()
+	}
+}